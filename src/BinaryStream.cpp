@@ -0,0 +1,22 @@
+#include "BinaryStream.h"
+#include "client.h"
+
+using namespace ADDON;
+
+bool BinaryStream::LoadFile(const std::string &file, std::vector<char> &content)
+{
+  void *fileHandle = XBMC->OpenFile(file.c_str(), 0);
+  if (!fileHandle)
+    return false;
+
+  content.clear();
+  char buffer[4096];
+  while (ssize_t bytesRead = XBMC->ReadFile(fileHandle, buffer, sizeof(buffer)))
+  {
+    if (bytesRead < 0)
+      break;
+    content.insert(content.end(), buffer, buffer + bytesRead);
+  }
+  XBMC->CloseFile(fileHandle);
+  return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_BINARYSTREAM_H
+#define PVR_DVBVIEWER_BINARYSTREAM_H
+
+#include "StringView.h"
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* Helpers for the binary files in addon_data. Values are stored in host
+ * byte order, strings are prefixed by their length
+ */
+namespace BinaryStream
+{
+  template<typename T>
+  inline void Append(std::vector<char> &content, const T &value)
+  {
+    const char *ptr = reinterpret_cast<const char *>(&value);
+    content.insert(content.end(), ptr, ptr + sizeof(T));
+  }
+
+  inline void AppendString(std::vector<char> &content, StringView value)
+  {
+    Append<uint32_t>(content, value.size());
+    content.insert(content.end(), value.begin(), value.end());
+  }
+
+  /*!< @brief read the whole file into content */
+  bool LoadFile(const std::string &file, std::vector<char> &content);
+
+  /*!< @brief bounds checked reads from a loaded file */
+  class Reader
+  {
+  public:
+    Reader(const std::vector<char> &content)
+      : m_ptr(content.data()), m_end(content.data() + content.size())
+    {}
+
+    template<typename T>
+    bool Read(T &value)
+    {
+      if (static_cast<size_t>(m_end - m_ptr) < sizeof(T))
+        return false;
+      memcpy(&value, m_ptr, sizeof(T));
+      m_ptr += sizeof(T);
+      return true;
+    }
+
+    /*!< @brief skip magic if the data starts with it */
+    bool ReadMagic(const char *magic)
+    {
+      size_t length = strlen(magic);
+      if (static_cast<size_t>(m_end - m_ptr) < length
+          || memcmp(m_ptr, magic, length) != 0)
+        return false;
+      m_ptr += length;
+      return true;
+    }
+
+    bool ReadString(std::string &value)
+    {
+      uint32_t length;
+      if (!Read(length) || static_cast<size_t>(m_end - m_ptr) < length)
+        return false;
+      value.assign(m_ptr, length);
+      m_ptr += length;
+      return true;
+    }
+
+  private:
+    const char *m_ptr, *m_end;
+  };
+}
+
+#endif
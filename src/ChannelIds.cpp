@@ -0,0 +1,118 @@
+#include "ChannelIds.h"
+#include "BinaryStream.h"
+#include "client.h"
+#include <inttypes.h>
+#include <vector>
+
+#define CHANNELIDS_MAGIC  "DVBCID01"
+/* ids are positive ints in Kodi's database */
+#define CHANNELID_MAX     (0x7FFFFFFFU)
+
+using namespace ADDON;
+using namespace BinaryStream;
+
+ChannelIds::ChannelIds(const std::string &file)
+  : m_file(file)
+{
+  if (Load())
+    XBMC->Log(LOG_DEBUG, "ChannelIds: Loaded %u collisions",
+        m_collisions.size());
+}
+
+void ChannelIds::Reset()
+{
+  m_used.clear();
+}
+
+unsigned int ChannelIds::Get(uint64_t backendId)
+{
+  auto collision = m_collisions.find(backendId);
+  unsigned int id = (collision != m_collisions.end()) ? collision->second
+    : Hash(backendId);
+  bool reserved = (collision == m_collisions.end() && m_reserved.count(id));
+  auto used = m_used.find(id);
+  if (!reserved && used == m_used.end())
+  {
+    m_used[id] = backendId;
+    return id;
+  }
+
+  // the same channel twice in the list only needs an id for this session
+  bool duplicate = (used != m_used.end() && used->second == backendId);
+  do
+    id = id % CHANNELID_MAX + 1;
+  while (m_reserved.count(id) || m_used.count(id));
+  m_used[id] = backendId;
+
+  if (!duplicate)
+  {
+    XBMC->Log(LOG_NOTICE, "ChannelIds: Collision for %" PRIu64 ". Using %u",
+        backendId, id);
+    m_collisions[backendId] = id;
+    m_reserved.insert(id);
+    Save();
+  }
+  return id;
+}
+
+unsigned int ChannelIds::Hash(uint64_t backendId)
+{
+  // splitmix64 finalizer. backend ids differ in a few bits only
+  uint64_t hash = backendId;
+  hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+  hash ^= hash >> 31;
+  return static_cast<unsigned int>(hash % CHANNELID_MAX) + 1;
+}
+
+bool ChannelIds::Load()
+{
+  std::vector<char> content;
+  if (!LoadFile(m_file, content))
+    return false;
+
+  Reader reader(content);
+  uint32_t count;
+  if (!reader.ReadMagic(CHANNELIDS_MAGIC) || !reader.Read(count))
+    return false;
+
+  std::map<uint64_t, unsigned int> collisions;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    uint64_t backendId;
+    uint32_t id;
+    if (!reader.Read(backendId) || !reader.Read(id))
+      return false;
+    collisions[backendId] = id;
+  }
+  m_collisions.swap(collisions);
+  for (auto &collision : m_collisions)
+    m_reserved.insert(collision.second);
+  return true;
+}
+
+bool ChannelIds::Save()
+{
+  std::string dir = m_file.substr(0, m_file.rfind('/'));
+  if (!XBMC->DirectoryExists(dir.c_str()) && !XBMC->CreateDirectory(dir.c_str()))
+    return false;
+
+  void *fileHandle = XBMC->OpenFileForWrite(m_file.c_str(), true);
+  if (!fileHandle)
+  {
+    XBMC->Log(LOG_ERROR, "ChannelIds: Unable to write %s", m_file.c_str());
+    return false;
+  }
+
+  std::vector<char> content(CHANNELIDS_MAGIC,
+      CHANNELIDS_MAGIC + strlen(CHANNELIDS_MAGIC));
+  Append<uint32_t>(content, m_collisions.size());
+  for (auto &collision : m_collisions)
+  {
+    Append<uint64_t>(content, collision.first);
+    Append<uint32_t>(content, collision.second);
+  }
+  XBMC->WriteFile(fileHandle, content.data(), content.size());
+  XBMC->CloseFile(fileHandle);
+  return true;
+}
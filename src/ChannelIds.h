@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_CHANNELIDS_H
+#define PVR_DVBVIEWER_CHANNELIDS_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+/*!< @brief stable 32 bit ids for the 64 bit backend ids of channels. An id
+ * is a hash of the backend id, so it doesn't depend on the position in the
+ * channel list. Collisions get the next free id, which is remembered on
+ * disk to keep it across sessions
+ */
+class ChannelIds
+{
+public:
+  ChannelIds(const std::string &file);
+  /*!< @brief start assigning ids for a new channel list */
+  void Reset();
+  /*!< @brief id of the backend id. unique within the current list */
+  unsigned int Get(uint64_t backendId);
+
+private:
+  static unsigned int Hash(uint64_t backendId);
+  bool Load();
+  bool Save();
+
+  std::string m_file;
+  /*!< @brief backend id -> id for backend ids whose hash was taken */
+  std::map<uint64_t, unsigned int> m_collisions;
+  /*!< @brief ids of m_collisions. no hash may take them */
+  std::set<unsigned int> m_reserved;
+  /*!< @brief id -> backend id of the current list */
+  std::unordered_map<unsigned int, uint64_t> m_used;
+};
+
+#endif
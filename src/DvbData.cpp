@@ -1,6 +1,8 @@
 #include "DvbData.h"
+#include "XmlParallelParser.h"
+#include "XmlScan.h"
 #include "client.h"
-#include "util/XMLUtils.h"
+#include "p8-platform/util/timeutils.h"
 #include "p8-platform/util/util.h"
 #include "p8-platform/util/StringUtils.h"
 #include <tinyxml.h>
@@ -8,11 +10,29 @@
 #include <set>
 #include <iterator>
 #include <sstream>
+#include <thread>
 #include <algorithm>
 
 using namespace ADDON;
 using namespace P8PLATFORM;
 
+/* content of a response without status code. error pages are HTML */
+static bool LooksLikeXML(const char *data, size_t size)
+{
+  StringView content(data, size);
+  if (content.substr(0, 3) == "\xEF\xBB\xBF")
+    content = content.substr(3);
+  size_t pos = 0;
+  while (pos < content.size() && isspace(static_cast<unsigned char>(content[pos])))
+    ++pos;
+  if (pos == content.size() || content[pos] != '<')
+    return false;
+  std::string tag = content.substr(pos, 9).str();
+  StringUtils::ToLower(tag);
+  return (!StringUtils::StartsWith(tag, "<html")
+      && !StringUtils::StartsWith(tag, "<!doctype"));
+}
+
 /* private copy until https://github.com/xbmc/kodi-platform/pull/2 get merged */
 static bool XMLUtils_GetString(const TiXmlNode* pRootNode, const char* strTag,
     std::string& strStringValue)
@@ -31,8 +51,9 @@ static bool XMLUtils_GetString(const TiXmlNode* pRootNode, const char* strTag,
 }
 
 Dvb::Dvb()
-  : m_state(PVR_CONNECTION_STATE_UNKNOWN), m_backendVersion(0), m_currentChannel(0),
-  m_nextTimerId(1)
+  : m_state(PVR_CONNECTION_STATE_UNKNOWN), m_backendVersion(0),
+  m_channelIds(ADDON_DATA_PATH "/channelids.dat"), m_currentChannel(0),
+  m_nextTimerId(1), m_snapshot(ADDON_DATA_PATH "/snapshot"), m_hasSnapshot(false)
 {
   TiXmlBase::SetCondenseWhiteSpace(false);
 
@@ -46,15 +67,43 @@ Dvb::Dvb()
 
   m_updateTimers = false;
   m_updateEPG    = false;
+  m_updateLogos  = false;
+  m_recordingsValidator = m_timersValidator = httpValidator();
+
+  m_recordingCache = nullptr;
+  if (g_recordingCacheSize > 0)
+    m_recordingCache = new RecordingCache(ADDON_DATA_PATH "/cache",
+        static_cast<uint64_t>(g_recordingCacheSize) * 1024 * 1024);
+  m_bulkEPGStart = m_bulkEPGEnd = m_bulkEPGFetched = 0;
+  m_bulkEPGSupported = true;
+  m_epgCache = nullptr;
+  if (g_epgCacheTTL > 0)
+    m_epgCache = new EpgCache(ADDON_DATA_PATH "/epg", g_epgCacheTTL * 3600);
+  m_epgPrefetcher = nullptr;
+  if (m_epgCache && g_epgPrefetchConnections > 0)
+    m_epgPrefetcher = new EpgPrefetcher(g_epgPrefetchConnections,
+        [this] (uint64_t epgId) { PrefetchEPG(epgId); });
+  m_logoCache = nullptr;
+  if (!g_lowPerformance)
+    m_logoCache = new LogoCache(ADDON_DATA_PATH "/logos", LOGO_DOWNLOADS,
+        [this] ()
+        {
+          CLockObject lock(m_mutex);
+          m_updateLogos = true;
+        });
+
+  // before Kodi asks for anything
+  m_hasSnapshot = LoadSnapshot();
   CreateThread();
 }
 
 Dvb::~Dvb()
 {
   StopThread();
-
-  for (auto channel : m_channels)
-    delete channel;
+  SAFE_DELETE(m_logoCache);
+  SAFE_DELETE(m_epgPrefetcher);
+  SAFE_DELETE(m_recordingCache);
+  SAFE_DELETE(m_epgCache);
 }
 
 bool Dvb::IsConnected()
@@ -62,6 +111,11 @@ bool Dvb::IsConnected()
   return m_state == PVR_CONNECTION_STATE_CONNECTED;
 }
 
+bool Dvb::HasData()
+{
+  return (IsConnected() || m_hasSnapshot);
+}
+
 std::string Dvb::GetBackendName()
 {
   // RS api doesn't provide a reliable way to extract the server name
@@ -96,22 +150,23 @@ unsigned int Dvb::GetCurrentClientChannel(void)
 
 bool Dvb::GetChannels(ADDON_HANDLE handle, bool radio)
 {
-  for (auto channel : m_channels)
+  CLockObject lock(m_mutex);
+  for (auto &channel : m_channels)
   {
-    if (channel->hidden)
+    if (channel.hidden)
       continue;
-    if (channel->radio != radio)
+    if (channel.radio != radio)
       continue;
 
     PVR_CHANNEL xbmcChannel;
     memset(&xbmcChannel, 0, sizeof(PVR_CHANNEL));
-    xbmcChannel.iUniqueId         = channel->id;
-    xbmcChannel.bIsRadio          = channel->radio;
-    xbmcChannel.iChannelNumber    = channel->frontendNr;
-    xbmcChannel.iEncryptionSystem = channel->encrypted;
+    xbmcChannel.iUniqueId         = channel.id;
+    xbmcChannel.bIsRadio          = channel.radio;
+    xbmcChannel.iChannelNumber    = channel.frontendNr;
+    xbmcChannel.iEncryptionSystem = channel.encrypted;
     xbmcChannel.bIsHidden         = false;
-    PVR_STRCPY(xbmcChannel.strChannelName, channel->name.c_str());
-    PVR_STRCPY(xbmcChannel.strIconPath,    channel->logo.c_str());
+    PVR_STRCPY(xbmcChannel.strChannelName, channel.name.c_str());
+    PVR_STRCPY(xbmcChannel.strIconPath,    channel.logo.c_str());
 
     PVR->TransferChannelEntry(handle, &xbmcChannel);
   }
@@ -121,93 +176,80 @@ bool Dvb::GetChannels(ADDON_HANDLE handle, bool radio)
 bool Dvb::GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANNEL &channelinfo,
     time_t start, time_t end)
 {
-  DvbChannel *channel = m_channels[channelinfo.iUniqueId - 1];
-
-  const std::string &url = BuildURL("api/epg.html?lvl=2&channel=%" PRIu64
-      "&start=%f&end=%f", channel->epgId, start/86400.0 + DELPHI_DATE,
-      end/86400.0 + DELPHI_DATE);
-  const httpResponse &res = GetHttpXML(url);
-  if (res.error)
+  // the channel table may be replaced while the EPG is fetched
+  uint64_t epgId;
+  std::string name;
   {
-    SetConnectionState(PVR_CONNECTION_STATE_SERVER_UNREACHABLE);
-    return false;
+    CLockObject lock(m_mutex);
+    DvbChannel *channel = GetChannelById(channelinfo.iUniqueId);
+    if (!channel)
+      return false;
+    epgId = channel->epgId;
+    name = channel->name;
   }
 
-  TiXmlDocument doc;
-  doc.Parse(res.content.c_str());
-  if (doc.Error())
+  EpgStore events;
+  if (m_epgCache)
   {
-    XBMC->Log(LOG_ERROR, "Unable to parse EPG. Error: %s",
-        doc.ErrorDesc());
-    return false;
+    // only fetch what isn't cached yet
+    for (auto &window : m_epgCache->Missing(epgId, start, end))
+    {
+      if (!FetchEPG(epgId, window.first, window.second, events))
+        return false;
+      m_epgCache->Store(epgId, window, events);
+    }
+    m_epgCache->Get(epgId, start, end, events);
   }
+  else if (!FetchEPG(epgId, start, end, events))
+    return false;
+  StoreEPGDigest(epgId, events, start, end);
 
+  bool prepend = (g_prependOutline == PrependOutline::IN_EPG
+      || g_prependOutline == PrependOutline::ALWAYS);
+  std::string merged;
   unsigned int numEPG = 0;
-  for (TiXmlElement *xEntry = doc.RootElement()->FirstChildElement("programme");
-      xEntry; xEntry = xEntry->NextSiblingElement("programme"))
+  for (auto &event : events.Events())
   {
-    DvbEPGEntry entry;
-    entry.channel = channel;
-    entry.start   = ParseDateTime(xEntry->Attribute("start"));
-    entry.end     = ParseDateTime(xEntry->Attribute("stop"));
-
-    if (end > 1 && end < entry.end)
+    if (end > 1 && end < event.end)
        continue;
 
-    if (!XMLUtils::GetUInt(xEntry, "eventid", entry.id))
-      continue;
-
-    // since RS 1.26.0 the correct language is already merged into the elements
-    TiXmlNode *xTitles = xEntry->FirstChild("titles");
-    if (!xTitles || !XMLUtils_GetString(xTitles, "title", entry.title))
-      continue;
-
-    TiXmlNode *xDescriptions = xEntry->FirstChild("descriptions");
-    if (xDescriptions)
-      XMLUtils_GetString(xDescriptions, "description", entry.plot);
-
-    TiXmlNode *xEvents = xEntry->FirstChild("events");
-    if (xEvents)
+    const char *title = events.Text(event.title);
+    const char *plotOutline = events.Text(event.plotOutline);
+    const char *plot = events.Text(event.plot);
+    if (!*plot)
     {
-      XMLUtils_GetString(xEvents, "event", entry.plotOutline);
-      if (entry.plot.empty())
-      {
-        entry.plot = entry.plotOutline;
-        entry.plotOutline.clear();
-      }
-      else if (g_prependOutline == PrependOutline::IN_EPG
-          || g_prependOutline == PrependOutline::ALWAYS)
-      {
-        entry.plot.insert(0, entry.plotOutline + "\n");
-        entry.plotOutline.clear();
-      }
+      plot = plotOutline;
+      plotOutline = "";
+    }
+    else if (prepend)
+    {
+      merged.assign(plotOutline).append("\n").append(plot);
+      plot = merged.c_str();
+      plotOutline = "";
     }
-
-    XMLUtils::GetUInt(xEntry, "content", entry.genre);
 
     EPG_TAG broadcast;
     memset(&broadcast, 0, sizeof(EPG_TAG));
-    broadcast.iUniqueBroadcastId  = entry.id;
-    broadcast.strTitle            = entry.title.c_str();
+    broadcast.iUniqueBroadcastId  = event.id;
+    broadcast.strTitle            = title;
     broadcast.iUniqueChannelId    = channelinfo.iUniqueId;
-    broadcast.startTime           = entry.start;
-    broadcast.endTime             = entry.end;
-    broadcast.strPlotOutline      = entry.plotOutline.c_str();
-    broadcast.strPlot             = entry.plot.c_str();
-    broadcast.iGenreType          = entry.genre & 0xF0;
-    broadcast.iGenreSubType       = entry.genre & 0x0F;
+    broadcast.startTime           = event.start;
+    broadcast.endTime             = event.end;
+    broadcast.strPlotOutline      = plotOutline;
+    broadcast.strPlot             = plot;
+    broadcast.iGenreType          = event.genre & 0xF0;
+    broadcast.iGenreSubType       = event.genre & 0x0F;
     broadcast.iFlags              = EPG_TAG_FLAG_UNDEFINED;
 
     PVR->TransferEpgEntry(handle, &broadcast);
     ++numEPG;
 
     XBMC->Log(LOG_DEBUG, "%s: Loaded EPG entry '%u:%s': start=%u, end=%u",
-        __FUNCTION__, entry.id, entry.title.c_str(),
-        entry.start, entry.end);
+        __FUNCTION__, event.id, title, event.start, event.end);
   }
 
   XBMC->Log(LOG_INFO, "Loaded %u EPG entries for channel '%s'",
-      numEPG, channel->name.c_str());
+      numEPG, name.c_str());
   return true;
 }
 
@@ -219,6 +261,7 @@ unsigned int Dvb::GetChannelsAmount()
 
 bool Dvb::GetChannelGroups(ADDON_HANDLE handle, bool radio)
 {
+  CLockObject lock(m_mutex);
   for (auto &group : m_groups)
   {
     if (group.hidden)
@@ -239,6 +282,7 @@ bool Dvb::GetChannelGroups(ADDON_HANDLE handle, bool radio)
 bool Dvb::GetChannelGroupMembers(ADDON_HANDLE handle,
     const PVR_CHANNEL_GROUP &pvrGroup)
 {
+  CLockObject lock(m_mutex);
   unsigned int channelNumberInGroup = 1;
 
   for (auto &group : m_groups)
@@ -246,8 +290,9 @@ bool Dvb::GetChannelGroupMembers(ADDON_HANDLE handle,
     if (group.name != pvrGroup.strGroupName)
       continue;
 
-    for (auto channel : group.channels)
+    for (unsigned int index : group.channels)
     {
+      const DvbChannel *channel = &m_channels[index];
       PVR_CHANNEL_GROUP_MEMBER tag;
       memset(&tag, 0, sizeof(PVR_CHANNEL_GROUP_MEMBER));
       PVR_STRCPY(tag.strGroupName, pvrGroup.strGroupName);
@@ -320,7 +365,10 @@ bool Dvb::AddTimer(const PVR_TIMER &timer, bool update)
       repeat[i] = 'T';
   }
 
-  uint64_t backendId = m_channels[timer.iClientChannelUid - 1]->backendIds.front();
+  DvbChannel *channel = GetChannelById(timer.iClientChannelUid);
+  if (!channel)
+    return false;
+  uint64_t backendId = channel->backendIds.front();
   if (!update)
     GetHttpXML(BuildURL("api/timeradd.html?ch=%" PRIu64 "&dor=%u&enable=1"
         "&start=%u&stop=%u&prio=%d&days=%s&title=%s&encoding=255",
@@ -375,48 +423,34 @@ unsigned int Dvb::GetTimersAmount()
 bool Dvb::GetRecordings(ADDON_HANDLE handle)
 {
   CLockObject lock(m_mutex);
-  httpResponse &&res = GetHttpXML(BuildURL("api/recordings.html?utf8=1"
-      "&images=1"));
-  if (res.error)
-  {
-    SetConnectionState(PVR_CONNECTION_STATE_SERVER_UNREACHABLE);
-    return false;
-  }
-
-  TiXmlDocument doc;
-  RemoveNullChars(res.content);
-  doc.Parse(res.content.c_str());
-  if (doc.Error())
-  {
-    XBMC->Log(LOG_ERROR, "Unable to parse recordings. Error: %s",
-        doc.ErrorDesc());
-    return false;
-  }
-
-  TiXmlElement *root = doc.RootElement();
-
   // there's no need to merge new recordings in older ones as XBMC does this
   // already for us (using strRecordingId). so just parse all recordings again
   std::vector<DvbRecording> recordings;
   m_recordingAmount = 0;
+  m_recordingFiles.clear();
 
   // group name and its size/amount of recordings
   std::map<std::string, unsigned int> groups;
 
-  // insert recordings in reverse order
-  for (TiXmlNode *xNode = root->LastChild("recording");
-      xNode; xNode = xNode->PreviousSibling("recording"))
+  // recording, its group name and its file on the backend
+  struct ParsedRecording
   {
-    TiXmlElement *xRecording = xNode->ToElement();
-    if (!xRecording)
-      continue;
-
     DvbRecording recording;
-    recording.id = xRecording->Attribute("id");
-    xRecording->QueryUnsignedAttribute("content", &recording.genre);
-    XMLUtils_GetString(xRecording, "title",   recording.title);
-    XMLUtils_GetString(xRecording, "info",    recording.plotOutline);
-    XMLUtils_GetString(xRecording, "desc",    recording.plot);
+    std::string group, file;
+  };
+  std::vector<ParsedRecording> parsedRecordings;
+
+  // runs on the parser threads
+  auto parseRecording = [&] (const XmlElement &xRecording,
+      ParsedRecording &parsed)
+  {
+    DvbRecording &recording = parsed.recording;
+    if (!xRecording.GetAttribute("id", recording.id))
+      return false;
+    xRecording.QueryUnsignedAttribute("content", &recording.genre);
+    xRecording.GetString("title",   recording.title);
+    xRecording.GetString("info",    recording.plotOutline);
+    xRecording.GetString("desc",    recording.plot);
     if (recording.plot.empty())
     {
       recording.plot = recording.plotOutline;
@@ -430,31 +464,38 @@ bool Dvb::GetRecordings(ADDON_HANDLE handle)
     }
 
     /* fetch and search channel */
-    XMLUtils_GetString(xRecording, "channel", recording.channelName);
-    recording.channel = GetChannel([&] (const DvbChannel *channel)
-        {
-          return (channel->backendName == recording.channelName);
-        });
+    xRecording.GetString("channel", recording.channelName);
+    recording.channel = GetChannelByBackendName(recording.channelName);
     if (recording.channel)
       recording.channelName = recording.channel->name;
 
     std::string thumbnail;
-    if (!g_lowPerformance && XMLUtils_GetString(xRecording, "image", thumbnail))
+    if (!g_lowPerformance && xRecording.GetString("image", thumbnail))
       recording.thumbnail = BuildURL("upnp/thumbnails/video/%s",
           thumbnail.c_str());
 
-    std::string startTime = xRecording->Attribute("start");
+    StringView startTime, duration;
+    xRecording.Attribute("start", startTime);
     recording.start = ParseDateTime(startTime);
 
-    int hours, mins, secs;
-    sscanf(xRecording->Attribute("duration"), "%02d%02d%02d", &hours, &mins, &secs);
+    int hours = 0, mins = 0, secs = 0;
+    if (xRecording.Attribute("duration", duration))
+    {
+      StringParser::ParseDigits(duration, 0, 2, hours);
+      StringParser::ParseDigits(duration, 2, 2, mins);
+      StringParser::ParseDigits(duration, 4, 2, secs);
+    }
     recording.duration = hours*60*60 + mins*60 + secs;
 
-    std::string group("Unknown");
+    if (g_directAccess)
+      xRecording.GetString("file", parsed.file);
+
+    std::string &group = parsed.group;
+    group = "Unknown";
     switch(g_groupRecordings)
     {
       case DvbRecording::Grouping::BY_DIRECTORY:
-        if (!XMLUtils_GetString(xRecording, "file", group))
+        if (!xRecording.GetString("file", group))
           break;
         StringUtils::ToLower(group);
         for (auto &recf : m_recfolders)
@@ -468,8 +509,8 @@ bool Dvb::GetRecordings(ADDON_HANDLE handle)
         }
         break;
       case DvbRecording::Grouping::BY_DATE:
-        group = StringUtils::Format("%s/%s", startTime.substr(0, 4).c_str(),
-            startTime.substr(4, 2).c_str());
+        group = StringUtils::Format("%s/%s", startTime.substr(0, 4).str().c_str(),
+            startTime.substr(4, 2).str().c_str());
         break;
       case DvbRecording::Grouping::BY_FIRST_LETTER:
         group = toupper(recording.title[0]);
@@ -478,7 +519,7 @@ bool Dvb::GetRecordings(ADDON_HANDLE handle)
         group = recording.channelName;
         break;
       case DvbRecording::Grouping::BY_SERIES:
-        XMLUtils_GetString(xRecording, "series", group);
+        xRecording.GetString("series", group);
         break;
       case DvbRecording::Grouping::BY_TITLE:
         group = recording.title;
@@ -487,14 +528,69 @@ bool Dvb::GetRecordings(ADDON_HANDLE handle)
         group = "";
         break;
     }
-    recording.group = groups.emplace(group, 0).first;
+    return true;
+  };
+
+  // the periodic change check might have fetched the current list already
+  std::string content;
+  bool fetched = true;
+  if (!IsConnected())
+  {
+    fetched = false;
+    if (!m_snapshot.LoadRecordings(content))
+      return false;
+  }
+  else if (!m_recordingsContent.empty())
+    content.swap(m_recordingsContent);
+  else
+  {
+    // Kodi needs the full list, so don't send any conditional headers
+    httpValidator validator = {};
+    httpResponse &&res = GetHttpXML(BuildURL(RECORDINGS_URL), &validator);
+    if (res.error)
+    {
+      SetConnectionState(PVR_CONNECTION_STATE_SERVER_UNREACHABLE);
+      return false;
+    }
+    m_recordingsValidator = validator;
+    content.swap(res.content);
+  }
+
+  XmlParallelParser parser("recording", (g_parallelParsing)
+      ? std::thread::hardware_concurrency() : 1);
+  if (!parser.Parse(content, parseRecording, parsedRecordings))
+  {
+    XBMC->Log(LOG_ERROR, "Unable to parse recordings. Error: %s",
+        parser.ErrorDesc().c_str());
+    return false;
+  }
+  if (fetched)
+    m_snapshot.SaveRecordings(content);
+
+  // merge in document order
+  for (auto &parsed : parsedRecordings)
+  {
+    DvbRecording &recording = parsed.recording;
+    if (!parsed.file.empty())
+      m_recordingFiles[recording.id] = parsed.file;
+    recording.group = groups.emplace(parsed.group, 0).first;
     ++recording.group->second;
+    recordings.push_back(std::move(recording));
+  }
 
-    recordings.push_back(recording);
+  // seek indexes of deleted recordings are of no use anymore
+  if (fetched)
+  {
+    std::set<std::string> recordingIds;
+    for (auto &recording : recordings)
+      recordingIds.insert(recording.id);
+    RecordingIndex::Prune(recordingIds);
   }
 
-  for (auto &recording : recordings)
+  // insert recordings in reverse order
+  for (auto it = recordings.rbegin(); it != recordings.rend(); ++it)
   {
+    DvbRecording &recording = *it;
     PVR_RECORDING recinfo;
     memset(&recinfo, 0, sizeof(PVR_RECORDING));
     PVR_STRCPY(recinfo.strRecordingId,   recording.id.c_str());
@@ -536,12 +632,19 @@ bool Dvb::GetRecordings(ADDON_HANDLE handle)
 
 bool Dvb::DeleteRecording(const PVR_RECORDING &recinfo)
 {
-  // RS api doesn't return a result
-  // TODO: check for http 200 / http 423
-  // but kodi curl wrapper doesn't expose m_httpresponse
-  GetHttpXML(BuildURL("api/recdelete.html?recid=%s&delfile=1",
-      recinfo.strRecordingId));
+  // RS api doesn't return a result. the recording is locked (http 423) if
+  // it's currently being played or recorded
+  const httpResponse &res = GetHttpXML(BuildURL("api/recdelete.html"
+      "?recid=%s&delfile=1", recinfo.strRecordingId));
+  if (res.code == 423)
+    XBMC->Log(LOG_NOTICE, "Recording %s is in use", recinfo.strRecordingId);
+  if (res.error)
+    return false;
 
+  {
+    CLockObject lock(m_mutex);
+    m_recordingsContent.clear();
+  }
   PVR->TriggerRecordingUpdate();
   return true;
 }
@@ -552,10 +655,9 @@ unsigned int Dvb::GetRecordingsAmount()
   return m_recordingAmount;
 }
 
-RecordingReader *Dvb::OpenRecordedStream(const PVR_RECORDING &recinfo)
+time_t Dvb::RecordingEnd(const PVR_RECORDING &recinfo)
 {
-  CLockObject lock(m_mutex);
-  time_t now = time(NULL), end = 0;
+  time_t now = time(NULL);
   std::string channelName = recinfo.strChannelName;
   auto timer = GetTimer([&] (const DvbTimer &timer)
       {
@@ -563,11 +665,108 @@ RecordingReader *Dvb::OpenRecordedStream(const PVR_RECORDING &recinfo)
             && timer.state != PVR_TIMER_STATE_CANCELLED
             && timer.channel->name == channelName);
       });
-  if (timer)
-    end = timer->end;
+  return (timer) ? timer->end : 0;
+}
+
+RecordingReader *Dvb::OpenRecordedStream(const PVR_RECORDING &recinfo)
+{
+  CLockObject lock(m_mutex);
+  time_t end = RecordingEnd(recinfo);
 
-  return new RecordingReader(BuildURL("upnp/recordings/%s.ts",
-        recinfo.strRecordingId), end);
+  std::string path, cacheFile;
+  uint64_t cachedLen = 0;
+  bool complete = false;
+  if (m_recordingCache && !end)
+  {
+    // play a complete copy without touching the network at all
+    if (m_recordingCache->Lookup(recinfo.strRecordingId, cacheFile, cachedLen,
+          complete) && complete)
+    {
+      RecordingReader *reader = new RecordingReader(cacheFile, 0,
+          recinfo.strRecordingId);
+      if (reader->Start())
+        return reader;
+      delete reader;
+      cachedLen = 0;
+    }
+    if (g_cacheRecentRecordings)
+      m_recordingCache->Add(recinfo.strRecordingId,
+          BuildURL("upnp/recordings/%s.ts", recinfo.strRecordingId));
+  }
+
+  if (g_directAccess && GetLocalRecordingPath(recinfo.strRecordingId, path))
+  {
+    if (XBMC->FileExists(path.c_str(), false))
+    {
+      RecordingReader *reader = new RecordingReader(path, end,
+          recinfo.strRecordingId);
+      if (reader->Start())
+        return reader;
+      delete reader;
+    }
+    XBMC->Log(LOG_NOTICE, "Unable to access %s directly. Falling back to "
+        "streaming", path.c_str());
+  }
+
+  RecordingReader *reader = new RecordingReader(BuildURL("upnp/recordings/%s.ts",
+        recinfo.strRecordingId), end, recinfo.strRecordingId);
+  if (cachedLen)
+    reader->UseCache(cacheFile, cachedLen);
+  if (reader->Start())
+    return reader;
+  delete reader;
+  return nullptr;
+}
+
+void Dvb::CloseRecordedStream()
+{
+  if (m_recordingCache)
+    m_recordingCache->Unpin();
+}
+
+bool Dvb::CacheRecording(const PVR_RECORDING &recinfo)
+{
+  if (!m_recordingCache)
+    return false;
+  // a copy of an ongoing recording would end where the download did
+  CLockObject lock(m_mutex);
+  if (RecordingEnd(recinfo))
+  {
+    XBMC->Log(LOG_NOTICE, "Recording %s is still ongoing. Not caching it",
+        recinfo.strRecordingId);
+    return false;
+  }
+  m_recordingCache->Add(recinfo.strRecordingId,
+      BuildURL("upnp/recordings/%s.ts", recinfo.strRecordingId));
+  return true;
+}
+
+bool Dvb::GetLocalRecordingPath(const std::string &recordingId,
+    std::string &path)
+{
+  auto file = m_recordingFiles.find(recordingId);
+  if (file == m_recordingFiles.end() || g_recordingsPath.empty())
+    return false;
+
+  // strip the longest matching recording folder of the backend
+  std::string relPath = file->second;
+  std::string lowerPath = relPath;
+  StringUtils::ToLower(lowerPath);
+  for (auto recf = m_recfolders.rbegin(); recf != m_recfolders.rend(); ++recf)
+  {
+    if (!StringUtils::StartsWith(lowerPath, *recf))
+      continue;
+    relPath = relPath.substr(recf->length());
+    break;
+  }
+  StringUtils::Replace(relPath, '\\', '/');
+  StringUtils::TrimLeft(relPath, "/");
+
+  path = g_recordingsPath;
+  if (!StringUtils::EndsWith(path, "/") && !StringUtils::EndsWith(path, "\\"))
+    path += "/";
+  path += relPath;
+  return true;
 }
 
 
@@ -582,6 +781,9 @@ bool Dvb::OpenLiveStream(const PVR_CHANNEL &channelinfo)
     if (!g_lowPerformance)
       m_updateEPG = true;
   }
+  // leave the bandwidth to live tv
+  if (m_recordingCache)
+    m_recordingCache->Pause(true);
   return true;
 }
 
@@ -589,11 +791,16 @@ void Dvb::CloseLiveStream(void)
 {
   CLockObject lock(m_mutex);
   m_currentChannel = 0;
+  if (m_recordingCache)
+    m_recordingCache->Pause(false);
 }
 
 const std::string Dvb::GetLiveStreamURL(const PVR_CHANNEL &channelinfo)
 {
-  DvbChannel *channel = m_channels[channelinfo.iUniqueId - 1];
+  CLockObject lock(m_mutex);
+  DvbChannel *channel = GetChannelById(channelinfo.iUniqueId);
+  if (!channel)
+    return "";
   uint64_t backendId = channel->backendIds.front();
   switch(g_transcoding)
   {
@@ -616,7 +823,7 @@ const std::string Dvb::GetLiveStreamURL(const PVR_CHANNEL &channelinfo)
 void *Dvb::Process()
 {
   XBMC->Log(LOG_DEBUG, "%s: Running...", __FUNCTION__);
-  int update = 0;
+  int update = 0, prefetch = 0, epgPoll = 0;
   int interval = (!g_lowPerformance) ? 60 : 300;
 
   // set PVR_CONNECTION_STATE_CONNECTING only once!
@@ -639,9 +846,20 @@ void *Dvb::Process()
         XBMC->Log(LOG_INFO, "Connection to the backend service successful.");
         SetConnectionState(PVR_CONNECTION_STATE_CONNECTED);
 
+        m_timersValidator = httpValidator();
+        // the timezone might have changed in the meantime
+        m_localTime.Reset();
         TimerUpdates();
+        SaveSnapshot();
         // force recording sync as Kodi won't update recordings on PVR restart
+        {
+          CLockObject lock(m_mutex);
+          m_recordingsContent.clear();
+        }
         PVR->TriggerRecordingUpdate();
+
+        QueueEPGPrefetch();
+        prefetch = 0;
       }
       else
       {
@@ -654,16 +872,54 @@ void *Dvb::Process()
     {
       Sleep(1000);
       ++update;
+      ++prefetch;
 
       CLockObject lock(m_mutex);
       if (m_updateEPG)
       {
         m_updateEPG = false;
+        // the recording service grabs the EPG of the new transponder. poll
+        // until it has, instead of hoping a fixed delay is long enough
+        epgPoll = EPG_POLL_TIMEOUT;
+        m_epgPollValidator = httpValidator();
+        // move the neighbours of the new channel to the front
+        QueueEPGPrefetch();
+      }
+
+      if (epgPoll > 0 && --epgPoll % EPG_POLL_INTERVAL == 0
+          && GetChannelById(m_currentChannel))
+      {
+        unsigned int channel = m_currentChannel;
+        uint64_t epgId = GetChannelById(channel)->epgId;
         m_mutex.Unlock();
-        Sleep(8000); /* Sleep enough time to let the recording service grab the EPG data */
+        bool changed = EPGChanged(epgId);
         m_mutex.Lock();
-        XBMC->Log(LOG_INFO, "Performing forced EPG update!");
-        PVR->TriggerEpgUpdate(m_currentChannel);
+        if (changed && channel == m_currentChannel)
+        {
+          epgPoll = 0;
+          XBMC->Log(LOG_INFO, "Performing forced EPG update!");
+          // the backend just grabbed fresh data. don't serve the cached one
+          if (m_epgCache)
+            m_epgCache->Invalidate(epgId);
+          PVR->TriggerEpgUpdate(channel);
+        }
+      }
+
+      if (m_updateLogos)
+      {
+        m_updateLogos = false;
+        if (UpdateLogos())
+        {
+          XBMC->Log(LOG_INFO, "Performing channel update for new logos!");
+          PVR->TriggerChannelUpdate();
+          SaveSnapshot();
+        }
+      }
+
+      if (prefetch >= EPG_PREFETCH_INTERVAL)
+      {
+        prefetch = 0;
+        QueueEPGPrefetch();
       }
 
       if (m_updateTimers)
@@ -682,7 +938,8 @@ void *Dvb::Process()
         update = 0;
         XBMC->Log(LOG_INFO, "Performing timer/recording updates!");
         TimerUpdates();
-        PVR->TriggerRecordingUpdate();
+        if (RecordingsChanged())
+          PVR->TriggerRecordingUpdate();
       }
     }
   }
@@ -691,25 +948,166 @@ void *Dvb::Process()
 }
 
 
-Dvb::httpResponse Dvb::GetHttpXML(const std::string& url)
+bool Dvb::RecordingsChanged()
 {
-  // TODO Kodi CURL api doesn't expose the http code. need to replace it
-  // afterwards handle connection failures here
-  // (PVR_CONNECTION_STATE_SERVER_UNREACHABLE)
-  httpResponse res = { true, "" };
-  void *fileHandle = XBMC->OpenFile(url.c_str(), READ_NO_CACHE);
-  if (fileHandle)
+  httpResponse &&res = GetHttpXML(BuildURL(RECORDINGS_URL),
+      &m_recordingsValidator);
+  if (res.error || res.unchanged)
+    return false;
+  // keep the list for the GetRecordings call we're going to trigger
+  m_recordingsContent.swap(res.content);
+  return true;
+}
+
+Dvb::httpResponse Dvb::GetHttpXML(const std::string& url,
+    httpValidator *validator, unsigned int timeout, XmlStreamParser *parser)
+{
+  // Kodi keeps the curl session of the last requests alive, so consecutive
+  // API calls reuse the connection to the backend
+  httpResponse res = {};
+  res.error = true;
+  void *fileHandle = XBMC->CURLCreate(url.c_str());
+  if (!fileHandle)
+    return res;
+  // we want to see the status code of failed requests too
+  XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_PROTOCOL,
+      "failonerror", "false");
+  XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_PROTOCOL,
+      "connection-timeout", std::to_string(timeout).c_str());
+  // the XML responses shrink to a fraction. curl inflates them on the fly
+  XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_PROTOCOL,
+      "acceptencoding", "gzip, deflate");
+  if (validator && !validator->etag.empty())
+    XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER,
+        "If-None-Match", validator->etag.c_str());
+  if (validator && !validator->lastModified.empty())
+    XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER,
+        "If-Modified-Since", validator->lastModified.c_str());
+  if (!XBMC->CURLOpen(fileHandle, READ_NO_CACHE))
   {
-    res.error = false;
-    char buffer[1024];
-    while (int bytesRead = XBMC->ReadFile(fileHandle, buffer, 1024))
-      res.content.append(buffer, bytesRead);
+    XBMC->Log(LOG_ERROR, "%s: No response from %s", __FUNCTION__,
+        StripCredentials(url).c_str());
     XBMC->CloseFile(fileHandle);
     return res;
   }
+
+  // status line e.g. "HTTP/1.1 200 OK"
+  if (char *protocol = XBMC->GetFilePropertyValue(fileHandle,
+      XFILE::FILE_PROPERTY_RESPONSE_PROTOCOL, ""))
+  {
+    sscanf(protocol, "%*s %d", &res.code);
+    XBMC->FreeString(protocol);
+  }
+  // older Kodi versions don't expose the status line. the code stays 0 and
+  // the content has to tell if it's an error page
+  bool sniff = (res.code == 0), xml = true;
+
+  for (const char *name : { "content-length", "content-type",
+      "content-encoding", "etag", "last-modified" })
+  {
+    char *value = XBMC->GetFilePropertyValue(fileHandle,
+        XFILE::FILE_PROPERTY_RESPONSE_HEADER, name);
+    if (!value)
+      continue;
+    if (*value)
+      res.headers[name] = value;
+    XBMC->FreeString(value);
+  }
+
+  // error pages are never passed to the parser
+  if (res.code < 200 || res.code >= 300)
+    parser = nullptr;
+
+  // the length is the one of the encoded content. it's just a hint
+  int64_t length = XBMC->GetFileLength(fileHandle);
+  if (length > 0 && !parser)
+    res.content.reserve(length);
+  uint64_t hash = HASH_INIT;
+  std::vector<char> buffer(HTTP_READ_SIZE);
+  bool readError = false;
+  while (ssize_t bytesRead = XBMC->ReadFile(fileHandle, buffer.data(),
+      buffer.size()))
+  {
+    if (bytesRead < 0)
+    {
+      readError = true;
+      break;
+    }
+    if (sniff)
+    {
+      sniff = false;
+      xml = LooksLikeXML(buffer.data(), bytesRead);
+      if (!xml)
+        parser = nullptr;
+    }
+    hash = HashContent(hash, buffer.data(), bytesRead);
+    // parse the data as it arrives instead of collecting it
+    if (parser)
+      parser->Feed(buffer.data(), bytesRead);
+    else
+      res.content.append(buffer.data(), bytesRead);
+  }
+  XBMC->CloseFile(fileHandle);
+
+  // a truncated body must not pass for a complete one
+  if (readError)
+  {
+    XBMC->Log(LOG_ERROR, "%s: Unable to read response from %s", __FUNCTION__,
+        StripCredentials(url).c_str());
+    return res;
+  }
+
+  if (res.code == 304)
+  {
+    res.error = false;
+    res.unchanged = true;
+    return res;
+  }
+
+  res.error = (res.code) ? (res.code < 200 || res.code >= 300) : !xml;
+  if (res.error)
+  {
+    if (res.code)
+      XBMC->Log(LOG_ERROR, "%s: HTTP %d from %s", __FUNCTION__, res.code,
+          StripCredentials(url).c_str());
+    else
+      XBMC->Log(LOG_ERROR, "%s: Unexpected response from %s", __FUNCTION__,
+          StripCredentials(url).c_str());
+    return res;
+  }
+
+  if (validator)
+  {
+    // hash the body as the backend doesn't necessarily send validators
+    res.unchanged = (hash == validator->hash);
+    validator->hash         = hash;
+    validator->etag         = res.headers["etag"];
+    validator->lastModified = res.headers["last-modified"];
+  }
   return res;
 }
 
+/* 64 bit FNV-1a. hash is HASH_INIT or the result of the previous chunk */
+uint64_t Dvb::HashContent(uint64_t hash, const char *data, size_t size)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+  for (const unsigned char *end = p + size; p < end; ++p)
+  {
+    hash ^= *p;
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+std::string Dvb::StripCredentials(const std::string& url)
+{
+  std::string::size_type start = url.find("://");
+  std::string::size_type end = url.find('@');
+  if (start == std::string::npos || end == std::string::npos || end < start)
+    return url;
+  return url.substr(0, start + strlen("://")) + url.substr(end + 1);
+}
+
 /* Copied from xbmc/URL.cpp */
 std::string Dvb::URLEncode(const std::string& data)
 {
@@ -736,6 +1134,8 @@ std::string Dvb::URLEncode(const std::string& data)
 
 bool Dvb::LoadChannels()
 {
+  // the table and its indexes are only replaced under the lock
+  CLockObject lock(m_mutex);
   const httpResponse &res = GetHttpXML(BuildURL("api/getchannelsxml.html"
       "?fav=1&subchannels=1&logo=1"));
   if (res.error)
@@ -755,15 +1155,34 @@ bool Dvb::LoadChannels()
     return false;
   }
 
-  m_channels.clear();
+  // the new list is compared with the current one once it's complete
+  DvbChannels_t oldChannels;
+  DvbGroups_t oldGroups;
+  oldChannels.swap(m_channels);
+  oldGroups.swap(m_groups);
+  unsigned int oldChannelAmount = m_channelAmount;
+  unsigned int oldGroupAmount = m_groupAmount;
+  m_channelIds.Reset();
   m_channelAmount = 0;
-  m_groups.clear();
   m_groupAmount = 0;
 
+  // timers and the indexes point into the previous tables. keep them if
+  // the new list can't be completed
+  auto restore = [&] ()
+    {
+      m_channels.swap(oldChannels);
+      m_groups.swap(oldGroups);
+      m_channelAmount = oldChannelAmount;
+      m_groupAmount = oldGroupAmount;
+      IndexChannels();
+    };
+
   TiXmlElement *root = doc.RootElement();
   if (!root->FirstChildElement("root"))
   {
     XBMC->Log(LOG_NOTICE, "Channel list is empty");
+    IndexChannels();
+    ChannelsLoaded(oldChannels, oldGroups);
     return true; // empty channel is fine
   }
 
@@ -784,6 +1203,7 @@ bool Dvb::LoadChannels()
   {
     XBMC->Log(LOG_NOTICE, "Favourites enabled but non defined");
     XBMC->QueueNotification(QUEUE_WARNING, XBMC->GetLocalizedString(30509));
+    restore();
     return false; // empty favourites is an error
   }
 
@@ -806,14 +1226,15 @@ bool Dvb::LoadChannels()
       for (TiXmlElement *xChannel = xGroup->FirstChildElement("channel");
           xChannel; xChannel = xChannel->NextSiblingElement("channel"))
       {
-        DvbChannel *channel = new DvbChannel();
+        m_channels.push_back(DvbChannel());
+        DvbChannel *channel = &m_channels.back();
         unsigned int flags = 0;
         xChannel->QueryUnsignedAttribute("flags", &flags);
         channel->radio      = !(flags & VIDEO_FLAG);
         channel->encrypted  = (flags & ENCRYPTED_FLAG);
         channel->name       = channel->backendName = xChannel->Attribute("name");
         channel->hidden     = g_useFavourites;
-        channel->frontendNr = (!channel->hidden) ? m_channels.size() + 1 : 0;
+        channel->frontendNr = (!channel->hidden) ? m_channels.size() : 0;
         xChannel->QueryValueAttribute<uint64_t>("EPGID", &channel->epgId);
 
         uint64_t backendId = 0;
@@ -822,7 +1243,11 @@ bool Dvb::LoadChannels()
 
         std::string logo;
         if (!g_lowPerformance && XMLUtils_GetString(xChannel, "logo", logo))
-          channel->logo = BuildURL("%s", logo.c_str());
+        {
+          channel->logoURL = BuildURL("%s", logo.c_str());
+          channel->logo = m_logoCache->Get(StripCredentials(channel->logoURL),
+              channel->logoURL);
+        }
 
         for (TiXmlElement* xSubChannel = xChannel->FirstChildElement("subchannel");
             xSubChannel; xSubChannel = xSubChannel->NextSiblingElement("subchannel"))
@@ -832,11 +1257,9 @@ bool Dvb::LoadChannels()
           channel->backendIds.push_back(backendId);
         }
 
-        //FIXME: PVR_CHANNEL.UniqueId is uint32 but DVBViewer ids are uint64
-        // so generate our own unique ids, at least for this session
-        channel->id = m_channels.size() + 1;
-        m_channels.push_back(channel);
-        group->channels.push_back(channel);
+        // inserting channels on the backend doesn't change the ids
+        channel->id = m_channelIds.Get(channel->backendIds.front());
+        group->channels.push_back(m_channels.size() - 1);
         if (!channel->hidden)
           ++m_channelAmount;
 
@@ -846,6 +1269,9 @@ bool Dvb::LoadChannels()
     }
   }
 
+  // the favourites are resolved through the indexes
+  IndexChannels();
+
   if (g_useFavourites && !g_useFavouritesFile)
   {
     m_groups.clear();
@@ -868,12 +1294,7 @@ bool Dvb::LoadChannels()
       {
         uint64_t backendId = 0;
         xChannel->QueryValueAttribute<uint64_t>("ID", &backendId);
-        DvbChannel *channel = GetChannel([&] (const DvbChannel *channel)
-            {
-              return (std::find(channel->backendIds.begin(),
-                    channel->backendIds.end(), backendId)
-                  != channel->backendIds.end());
-            });
+        DvbChannel *channel = GetChannelByBackendId(backendId);
         if (!channel)
         {
           XBMC->Log(LOG_NOTICE, "Favourites contains unresolvable channel: %s."
@@ -886,7 +1307,7 @@ bool Dvb::LoadChannels()
         channel->name = xChannel->Attribute("name");
         channel->hidden = false;
         channel->frontendNr = ++m_channelAmount;
-        group->channels.push_back(channel);
+        group->channels.push_back(channel - m_channels.data());
         if (!channel->radio)
           group->radio = false;
       }
@@ -900,6 +1321,7 @@ bool Dvb::LoadChannels()
       XBMC->Log(LOG_ERROR, "Unable to open local favourites.xml");
       SetConnectionState(PVR_CONNECTION_STATE_SERVER_MISMATCH,
           XBMC->GetLocalizedString(30504));
+      restore();
       return false;
     }
 
@@ -918,6 +1340,7 @@ bool Dvb::LoadChannels()
           doc.ErrorDesc());
       SetConnectionState(PVR_CONNECTION_STATE_SERVER_MISMATCH,
           XBMC->GetLocalizedString(30505));
+      restore();
       return false;
     }
 
@@ -972,12 +1395,7 @@ bool Dvb::LoadChannels()
           channelName = ConvertToUtf8(channelName);
         }
 
-        DvbChannel *channel = GetChannel([&] (const DvbChannel *channel)
-            {
-              return (std::find(channel->backendIds.begin(),
-                    channel->backendIds.end(), backendId)
-                  != channel->backendIds.end());
-            });
+        DvbChannel *channel = GetChannelByBackendId(backendId);
         if (!channel)
         {
           const char *descr = (channelName.empty()) ? xEntry->GetText()
@@ -996,7 +1414,7 @@ bool Dvb::LoadChannels()
 
         if (group)
         {
-          group->channels.push_back(channel);
+          group->channels.push_back(channel - m_channels.data());
           if (!channel->radio)
             group->radio = false;
         }
@@ -1005,96 +1423,143 @@ bool Dvb::LoadChannels()
 
     // assign channel number to remaining channels
     unsigned int channelNumber = m_channelAmount;
-    for (auto channel : m_channels)
+    for (auto &channel : m_channels)
     {
-      if (!channel->frontendNr)
-        channel->frontendNr = ++channelNumber;
+      if (!channel.frontendNr)
+        channel.frontendNr = ++channelNumber;
     }
   }
 
   XBMC->Log(LOG_INFO, "Loaded (%u/%u) channels in (%u/%u) groups",
       m_channelAmount, m_channels.size(), m_groupAmount, m_groups.size());
-  // force channel sync as stream urls may have changed (e.g. rstp on/off)
-  PVR->TriggerChannelUpdate();
+  ChannelsLoaded(oldChannels, oldGroups);
   return true;
 }
 
-DvbTimers_t Dvb::LoadTimers()
+void Dvb::ChannelsLoaded(DvbChannels_t &oldChannels, DvbGroups_t &oldGroups)
+{
+  // equal tables have equal positions, so the indexes fit both
+  bool channelsChanged = (m_channels != oldChannels);
+  bool groupsChanged = (channelsChanged || m_groups != oldGroups);
+  if (m_logoCache && !m_channels.empty())
+  {
+    std::set<std::string> logos;
+    for (auto &channel : m_channels)
+    {
+      if (!channel.logoURL.empty())
+        logos.insert(StripCredentials(channel.logoURL));
+    }
+    m_logoCache->Prune(logos);
+  }
+  if (!channelsChanged)
+  {
+    // the previous table might be the snapshot, which has no logo urls
+    for (size_t i = 0; i < m_channels.size(); ++i)
+      oldChannels[i].logoURL = m_channels[i].logoURL;
+    m_channels.swap(oldChannels);
+  }
+  if (!groupsChanged)
+    m_groups.swap(oldGroups);
+
+  if (channelsChanged)
+  {
+    // timers point into the previous table. the next timer update takes
+    // care of timers whose channel is gone
+    for (auto it = m_timers.begin(); it != m_timers.end(); )
+    {
+      it->channel = GetChannelByBackendId(it->channelId);
+      it = (it->channel) ? it + 1 : m_timers.erase(it);
+    }
+    XBMC->Log(LOG_INFO, "Channel list changed");
+    PVR->TriggerChannelUpdate();
+  }
+  if (groupsChanged)
+    PVR->TriggerChannelGroupsUpdate();
+}
+
+DvbTimers_t Dvb::LoadTimers(bool &unchanged)
 {
   DvbTimers_t timers;
 
   // utf8=2 is correct here
-  httpResponse &&res = GetHttpXML(BuildURL("api/timerlist.html?utf8=2"));
+  httpResponse &&res = GetHttpXML(BuildURL("api/timerlist.html?utf8=2"),
+      &m_timersValidator);
+  unchanged = res.unchanged;
   if (res.error)
   {
     SetConnectionState(PVR_CONNECTION_STATE_SERVER_UNREACHABLE);
     return timers;
   }
-
-  TiXmlDocument doc;
-  RemoveNullChars(res.content);
-  doc.Parse(res.content.c_str());
-  if (doc.Error())
-  {
-    XBMC->Log(LOG_ERROR, "Unable to parse timers. Error: %s",
-        doc.ErrorDesc());
-    SetConnectionState(PVR_CONNECTION_STATE_SERVER_MISMATCH,
-        XBMC->GetLocalizedString(30506));
+  if (unchanged)
     return timers;
-  }
 
-  for (TiXmlElement *xTimer = doc.RootElement()->FirstChildElement("Timer");
-      xTimer; xTimer = xTimer->NextSiblingElement("Timer"))
+  XmlStreamParser parser("Timer", [&] (const XmlElement &xTimer)
   {
     DvbTimer timer;
 
-    if (!XMLUtils_GetString(xTimer, "GUID", timer.guid))
-      continue;
-    XMLUtils::GetUInt(xTimer, "ID", timer.backendId);
-    XMLUtils_GetString(xTimer, "Descr", timer.title);
+    if (!xTimer.GetString("GUID", timer.guid))
+      return;
+    xTimer.GetUInt("ID", timer.backendId);
+    xTimer.GetString("Descr", timer.title);
 
     uint64_t backendId = 0;
-    std::istringstream ss(xTimer->FirstChildElement("Channel")->Attribute("ID"));
-    ss >> backendId;
+    const XmlElement *xChannel = xTimer.FirstChildElement("Channel");
+    StringView channelId;
+    if (xChannel && xChannel->Attribute("ID", channelId))
+      StringParser::ParseUnsigned(channelId, backendId);
     if (!backendId)
-      continue;
+      return;
 
-    timer.channel = GetChannel([&] (const DvbChannel *channel)
-        {
-          return (std::find(channel->backendIds.begin(),
-                channel->backendIds.end(), backendId)
-              != channel->backendIds.end());
-        });
+    timer.channelId = backendId;
+    timer.channel = GetChannelByBackendId(backendId);
     if (!timer.channel)
-      continue;
+      return;
 
-    std::string startDate = xTimer->Attribute("Date");
-    startDate += xTimer->Attribute("Start");
+    StringView date, start, value;
+    xTimer.Attribute("Date", date);
+    xTimer.Attribute("Start", start);
+    std::string startDate(date.data(), date.size());
+    startDate.append(start.data(), start.size());
     timer.start = ParseDateTime(startDate, false);
-    timer.end   = timer.start + atoi(xTimer->Attribute("Dur")) * 60;
+    unsigned int duration = 0;
+    if (xTimer.Attribute("Dur", value))
+      StringParser::ParseUnsigned(value, duration);
+    timer.end   = timer.start + duration * 60;
 
     timer.weekdays = PVR_WEEKDAY_NONE;
-    const char *weekdays = xTimer->Attribute("Days");
-    for (unsigned int j = 0; weekdays && weekdays[j] != '\0'; ++j)
+    StringView weekdays;
+    xTimer.Attribute("Days", weekdays);
+    for (unsigned int j = 0; j < weekdays.size(); ++j)
     {
       if (weekdays[j] != '-')
         timer.weekdays += (1 << j);
     }
 
-    timer.priority    = atoi(xTimer->Attribute("Priority"));
+    timer.priority = 0;
+    if (xTimer.Attribute("Priority", value))
+      StringParser::ParseSigned(value, timer.priority);
     timer.updateState = DvbTimer::State::NEW;
     timer.state       = PVR_TIMER_STATE_SCHEDULED;
-    if (xTimer->Attribute("Enabled")[0] == '0')
+    if (xTimer.Attribute("Enabled", value) && !value.empty() && value[0] == '0')
       timer.state = PVR_TIMER_STATE_CANCELLED;
 
-    int tmp;
-    XMLUtils::GetInt(xTimer, "Recording", tmp);
+    int tmp = 0;
+    xTimer.GetInt("Recording", tmp);
     if (tmp == -1)
       timer.state = PVR_TIMER_STATE_RECORDING;
 
     timers.push_back(timer);
     XBMC->Log(LOG_DEBUG, "%s: Loaded timer entry '%s': start=%u, end=%u",
         __FUNCTION__, timer.title.c_str(), timer.start, timer.end);
+  });
+
+  if (!parser.Feed(res.content.data(), res.content.size()) || !parser.Finish())
+  {
+    XBMC->Log(LOG_ERROR, "Unable to parse timers. Error: %s",
+        parser.ErrorDesc().c_str());
+    SetConnectionState(PVR_CONNECTION_STATE_SERVER_MISMATCH,
+        XBMC->GetLocalizedString(30506));
+    return timers;
   }
 
   XBMC->Log(LOG_INFO, "Loaded %u timer entries", timers.size());
@@ -1103,10 +1568,17 @@ DvbTimers_t Dvb::LoadTimers()
 
 void Dvb::TimerUpdates()
 {
+  bool notModified;
+  DvbTimers_t &&newtimers = LoadTimers(notModified);
+  if (notModified)
+  {
+    XBMC->Log(LOG_DEBUG, "%s: Timer list unchanged", __FUNCTION__);
+    return;
+  }
+
   for (auto &timer : m_timers)
     timer.updateState = DvbTimer::State::NONE;
 
-  DvbTimers_t &&newtimers = LoadTimers();
   unsigned int updated = 0, unchanged = 0;
   for (auto &newtimer : newtimers)
   {
@@ -1164,17 +1636,99 @@ void Dvb::TimerUpdates()
   {
     XBMC->Log(LOG_INFO, "Changes in timerlist detected, triggering an update!");
     PVR->TriggerTimerUpdate();
+    SaveSnapshot();
   }
 }
 
-DvbChannel *Dvb::GetChannel(std::function<bool (const DvbChannel*)> func)
+bool Dvb::UpdateLogos()
 {
-  for (auto channel : m_channels)
+  bool changed = false;
+  for (auto &channel : m_channels)
   {
-    if (func(channel))
-      return channel;
+    if (channel.logoURL.empty())
+      continue;
+    const std::string &logo = m_logoCache->Get(
+        StripCredentials(channel.logoURL), channel.logoURL);
+    if (logo == channel.logo)
+      continue;
+    channel.logo = logo;
+    changed = true;
   }
-  return nullptr;
+  return changed;
+}
+
+void Dvb::IndexChannels()
+{
+  m_channelsById.clear();
+  m_channelsByBackendId.clear();
+  m_channelsByBackendName.clear();
+  for (unsigned int index = 0; index < m_channels.size(); ++index)
+  {
+    const DvbChannel &channel = m_channels[index];
+    m_channelsById[channel.id] = index;
+    // the first channel wins, same as a linear search would
+    for (uint64_t backendId : channel.backendIds)
+      m_channelsByBackendId.emplace(backendId, index);
+    m_channelsByBackendName.emplace(channel.backendName, index);
+  }
+}
+
+bool Dvb::LoadSnapshot()
+{
+  if (!m_snapshot.Load(m_channels, m_groups, m_timers))
+    return false;
+
+  IndexChannels();
+  m_channelAmount = m_groupAmount = 0;
+  for (auto &channel : m_channels)
+  {
+    if (!channel.hidden)
+      ++m_channelAmount;
+  }
+  for (auto &group : m_groups)
+  {
+    if (!group.hidden)
+      ++m_groupAmount;
+  }
+
+  for (auto it = m_timers.begin(); it != m_timers.end(); )
+  {
+    it->channel = GetChannelByBackendId(it->channelId);
+    it = (it->channel) ? it + 1 : m_timers.erase(it);
+  }
+  // ids of the snapshot are what Kodi knows
+  for (auto &timer : m_timers)
+    m_nextTimerId = std::max(m_nextTimerId, timer.id + 1);
+
+  XBMC->Log(LOG_INFO, "Restored %u channels, %u groups and %u timers from"
+      " the snapshot", m_channels.size(), m_groups.size(), m_timers.size());
+  return true;
+}
+
+void Dvb::SaveSnapshot()
+{
+  CLockObject lock(m_mutex);
+  m_snapshot.Save(m_channels, m_groups, m_timers);
+}
+
+DvbChannel *Dvb::GetChannelById(unsigned int id)
+{
+  auto it = m_channelsById.find(id);
+  return (it != m_channelsById.end()) ? &m_channels[it->second] : nullptr;
+}
+
+DvbChannel *Dvb::GetChannelByBackendId(uint64_t backendId)
+{
+  auto it = m_channelsByBackendId.find(backendId);
+  return (it != m_channelsByBackendId.end()) ? &m_channels[it->second]
+    : nullptr;
+}
+
+DvbChannel *Dvb::GetChannelByBackendName(const std::string &backendName)
+{
+  auto it = m_channelsByBackendName.find(backendName);
+  return (it != m_channelsByBackendName.end()) ? &m_channels[it->second]
+    : nullptr;
 }
 
 DvbTimer *Dvb::GetTimer(std::function<bool (const DvbTimer&)> func)
@@ -1191,21 +1745,24 @@ DvbTimer *Dvb::GetTimer(std::function<bool (const DvbTimer&)> func)
 void Dvb::RemoveNullChars(std::string& str)
 {
   /* favourites.xml and timers.xml sometimes have null chars that screw the xml */
-  str.erase(std::remove(str.begin(), str.end(), '\0'), str.end());
+  str.resize(XmlScan::StripNul(&str[0], str.size()));
 }
 
 bool Dvb::CheckBackendVersion()
 {
   const httpResponse &res = GetHttpXML(BuildURL("api/version.html"));
-  if (res.error)
+  if (res.code == 401 || res.code == 403)
+  {
+    XBMC->Log(LOG_ERROR, "Access denied. Check username and password");
+    SetConnectionState(PVR_CONNECTION_STATE_ACCESS_DENIED);
+    return false;
+  }
+  else if (res.error)
   {
     SetConnectionState(PVR_CONNECTION_STATE_SERVER_UNREACHABLE);
     return false;
   }
 
-  // TODO check access denied (PVR_CONNECTION_STATE_ACCESS_DENIED) vs timeout
-  // but kodi curl wrapper doesn't expose m_httpresponse
-
   TiXmlDocument doc;
   doc.Parse(res.content.c_str());
   if (doc.Error())
@@ -1280,7 +1837,8 @@ bool Dvb::UpdateBackendStatus(bool updateSettings)
       m_diskspace.used += (size - free) / 1024;
     }
 
-    if (updateSettings && g_groupRecordings == DvbRecording::Grouping::BY_DIRECTORY)
+    if (updateSettings && (g_directAccess
+        || g_groupRecordings == DvbRecording::Grouping::BY_DIRECTORY))
     {
       std::string recf = xFolder->GetText();
       StringUtils::ToLower(recf);
@@ -1288,7 +1846,8 @@ bool Dvb::UpdateBackendStatus(bool updateSettings)
     }
   }
 
-  if (updateSettings && g_groupRecordings == DvbRecording::Grouping::BY_DIRECTORY)
+  if (updateSettings && (g_directAccess
+        || g_groupRecordings == DvbRecording::Grouping::BY_DIRECTORY))
     std::sort(m_recfolders.begin(), m_recfolders.end(),
         [](const std::string& a, const std::string& b)
         {
@@ -1319,24 +1878,362 @@ void Dvb::SetConnectionState(PVR_CONNECTION_STATE state,
   }
 }
 
-time_t Dvb::ParseDateTime(const std::string& date, bool iso8601)
+bool Dvb::FetchEPG(uint64_t epgId, time_t start, time_t end,
+    EpgStore &events)
+{
+  if (g_bulkEPG && FetchBulkEPG(epgId, start, end, events))
+    return true;
+
+  const std::string &url = BuildURL("api/epg.html?lvl=2&channel=%" PRIu64
+      "&start=%f&end=%f", epgId, start/86400.0 + DELPHI_DATE,
+      end/86400.0 + DELPHI_DATE);
+  events.Clear();
+  XmlStreamParser parser("programme", EPGEntryFunc(events));
+  const httpResponse &res = GetHttpXML(url, nullptr, HTTP_TIMEOUT, &parser);
+  if (res.error)
+  {
+    SetConnectionState(PVR_CONNECTION_STATE_SERVER_UNREACHABLE);
+    return false;
+  }
+  if (!parser.Finish())
+  {
+    XBMC->Log(LOG_ERROR, "Unable to parse EPG. Error: %s",
+        parser.ErrorDesc().c_str());
+    return false;
+  }
+  return true;
+}
+
+XmlStreamParser::EntryFunc_t Dvb::EPGEntryFunc(EpgStore &events)
 {
-  struct tm timeinfo;
+  return [this, &events] (const XmlElement &xEntry)
+    {
+      DvbEPGEntry entry;
+      if (ParseEPGEntry(xEntry, entry))
+        events.Add(entry.id, entry.start, entry.end, entry.genre, entry.title,
+            entry.plotOutline, entry.plot);
+    };
+}
 
-  memset(&timeinfo, 0, sizeof(tm));
+bool Dvb::FetchBulkEPG(uint64_t epgId, time_t start, time_t end,
+    EpgStore &events)
+{
+  time_t now = time(NULL);
+  bool fetch;
+  {
+    CLockObject lock(m_epgMutex);
+    // failed attempts count too. otherwise every following channel would
+    // send the request for all channels again
+    fetch = (m_bulkEPGSupported && now - m_bulkEPGFetched >= BULK_EPG_LIFETIME);
+    if (fetch)
+    {
+      m_bulkEPG.clear();
+      m_bulkEPGStore.Clear();
+      m_bulkEPGFetched = now;
+    }
+  }
+
+  // the download runs without the lock. requests in the meantime fetch
+  // their channel on their own
+  if (fetch)
+  {
+    // an empty channel list means all channels
+    int64_t startTime = GetTimeMs();
+    const std::string &url = BuildURL("api/epg.html?lvl=2&start=%f&end=%f",
+        start/86400.0 + DELPHI_DATE, end/86400.0 + DELPHI_DATE);
+    // channels without entries are known to have none
+    std::map<uint64_t, std::vector<uint32_t>> bulkEPG;
+    {
+      CLockObject lock(m_mutex);
+      for (auto &channel : m_channels)
+        bulkEPG[channel.epgId];
+    }
+
+    // the response of all channels is big. entries go straight into the
+    // store as they arrive
+    EpgStore store;
+    size_t entries = 0;
+    XmlStreamParser parser("programme", [&] (const XmlElement &xEntry)
+    {
+      StringView channel;
+      uint64_t entryEpgId = 0;
+      if (xEntry.Attribute("channel", channel))
+        StringParser::ParseUnsigned(channel, entryEpgId);
+      DvbEPGEntry entry;
+      if (!ParseEPGEntry(xEntry, entry))
+        return;
+      ++entries;
+      auto it = bulkEPG.find(entryEpgId);
+      if (it == bulkEPG.end())
+        return;
+      it->second.push_back(store.Size());
+      store.Add(entry.id, entry.start, entry.end, entry.genre, entry.title,
+          entry.plotOutline, entry.plot);
+    });
+    const httpResponse &res = GetHttpXML(url, nullptr, HTTP_TIMEOUT, &parser);
+    if (res.error || !parser.Finish())
+    {
+      if (!res.error)
+        XBMC->Log(LOG_ERROR, "Unable to parse EPG. Error: %s",
+            parser.ErrorDesc().c_str());
+      return false;
+    }
+    store.Compact();
+    size_t matched = store.Size();
+
+    if (!matched)
+    {
+      // entries without a known channel mean the request isn't understood.
+      // no entries at all are more likely a backend without data yet than
+      // channels without EPG. don't let that end up in the cache
+      if (entries)
+      {
+        XBMC->Log(LOG_NOTICE, "Backend doesn't support bulk EPG requests");
+        CLockObject lock(m_epgMutex);
+        m_bulkEPGSupported = false;
+      }
+      return false;
+    }
+
+    XBMC->Log(LOG_INFO, "Loaded %u EPG entries of %u channels in one request"
+        " (%" PRId64 " ms, %u KiB)", matched, bulkEPG.size(),
+        GetTimeMs() - startTime, store.MemoryUsage() / 1024);
+
+    CLockObject lock(m_epgMutex);
+    m_bulkEPG.swap(bulkEPG);
+    m_bulkEPGStore = std::move(store);
+    m_bulkEPGStart = start;
+    m_bulkEPGEnd   = end;
+  }
+
+  CLockObject lock(m_epgMutex);
+  // a different window. don't throw away what's still to be served
+  if (start < m_bulkEPGStart || end > m_bulkEPGEnd)
+    return false;
+
+  auto it = m_bulkEPG.find(epgId);
+  if (it == m_bulkEPG.end())
+    return false;
+
+  events.Clear();
+  events.Reserve(it->second.size());
+  for (uint32_t index : it->second)
+  {
+    const EpgStore::Event &event = m_bulkEPGStore.Events()[index];
+    if (event.end <= start || event.start >= end)
+      continue;
+    events.Add(m_bulkEPGStore, event);
+  }
+  m_bulkEPG.erase(it);
+  return true;
+}
+
+bool Dvb::ParseEPGEntry(const XmlElement &xEntry, DvbEPGEntry &entry)
+{
+  StringView start, stop;
+  if (!xEntry.Attribute("start", start) || !xEntry.Attribute("stop", stop))
+    return false;
+  entry.start   = ParseDateTime(start);
+  entry.end     = ParseDateTime(stop);
+
+  if (!xEntry.GetUInt("eventid", entry.id))
+    return false;
+
+  // since RS 1.26.0 the correct language is already merged into the elements
+  const XmlElement *xTitles = xEntry.FirstChildElement("titles");
+  if (!xTitles || !xTitles->GetString("title", entry.title))
+    return false;
+
+  const XmlElement *xDescriptions = xEntry.FirstChildElement("descriptions");
+  if (xDescriptions)
+    xDescriptions->GetString("description", entry.plot);
+
+  const XmlElement *xEvents = xEntry.FirstChildElement("events");
+  if (xEvents)
+    xEvents->GetString("event", entry.plotOutline);
+
+  xEntry.GetUInt("content", entry.genre);
+  return true;
+}
+
+uint64_t Dvb::EPGDigest(const EpgStore &events, time_t start, time_t end)
+{
+  uint64_t hash = HASH_INIT;
+  for (auto &event : events.Events())
+  {
+    if (event.end <= start || event.start >= end)
+      continue;
+    hash = HashContent(hash, reinterpret_cast<const char *>(&event.id),
+        sizeof(event.id));
+    hash = HashContent(hash, reinterpret_cast<const char *>(&event.start),
+        sizeof(event.start));
+    hash = HashContent(hash, reinterpret_cast<const char *>(&event.end),
+        sizeof(event.end));
+    hash = HashContent(hash, reinterpret_cast<const char *>(&event.genre),
+        sizeof(event.genre));
+    // include the terminators so texts can't shift into each other
+    for (uint32_t text : { event.title, event.plotOutline, event.plot })
+      hash = HashContent(hash, events.Text(text), strlen(events.Text(text)) + 1);
+  }
+  return hash;
+}
+
+void Dvb::StoreEPGDigest(uint64_t epgId, const EpgStore &events,
+    time_t start, time_t end)
+{
+  // only if the whole digest window has been transferred
+  time_t window = time(NULL) / 3600 * 3600;
+  if (start > window || (end > 1 && end < window + EPG_DIGEST_WINDOW))
+    return;
+
+  CLockObject lock(m_epgMutex);
+  m_epgDigests[epgId] = { window,
+    EPGDigest(events, window, window + EPG_DIGEST_WINDOW) };
+}
+
+bool Dvb::EPGChanged(uint64_t epgId)
+{
+  time_t window = time(NULL) / 3600 * 3600;
+  const std::string &url = BuildURL("api/epg.html?lvl=2&channel=%" PRIu64
+      "&start=%f&end=%f", epgId, window/86400.0 + DELPHI_DATE,
+      (window + EPG_DIGEST_WINDOW)/86400.0 + DELPHI_DATE);
+  // same body as the last poll, so nothing new
+  EpgStore events;
+  XmlStreamParser parser("programme", EPGEntryFunc(events));
+  const httpResponse &res = GetHttpXML(url, &m_epgPollValidator,
+      HTTP_TIMEOUT, &parser);
+  if (res.error || res.unchanged || !parser.Finish())
+    return false;
+  uint64_t digest = EPGDigest(events, window, window + EPG_DIGEST_WINDOW);
+
+  bool known;
+  {
+    CLockObject lock(m_epgMutex);
+    auto it = m_epgDigests.find(epgId);
+    known = (it != m_epgDigests.end() && it->second.start == window);
+    if (known && it->second.digest == digest)
+      return false;
+  }
+
+  if (!known && m_epgCache)
+  {
+    // nothing transferred in this window. Kodi got its data from the cache
+    EpgStore cached;
+    m_epgCache->Get(epgId, window, window + EPG_DIGEST_WINDOW, cached);
+    if (cached.Size() && EPGDigest(cached, window,
+          window + EPG_DIGEST_WINDOW) == digest)
+    {
+      CLockObject lock(m_epgMutex);
+      m_epgDigests[epgId] = { window, digest };
+      return false;
+    }
+  }
+
+  // differs from what Kodi holds, or that is unknown. update once
+  CLockObject lock(m_epgMutex);
+  m_epgDigests[epgId] = { window, digest };
+  // a pending bulk result is outdated too
+  m_bulkEPG.erase(epgId);
+  return true;
+}
+
+void Dvb::PrefetchEPG(uint64_t epgId)
+{
+  if (!IsConnected())
+    return;
+
+  // whole days, so Kodi's requests during the next hours are covered too
+  time_t today = time(NULL) / DAY_SECS * DAY_SECS;
+  time_t start = today - EPG_PREFETCH_PAST * DAY_SECS;
+  time_t end   = today + (EPG_PREFETCH_FUTURE + 1) * DAY_SECS;
+
+  EpgStore events;
+  for (auto &window : m_epgCache->Missing(epgId, start, end))
+  {
+    if (!FetchEPG(epgId, window.first, window.second, events))
+      return;
+    m_epgCache->Store(epgId, window, events);
+  }
+}
+
+void Dvb::QueueEPGPrefetch()
+{
+  if (!m_epgPrefetcher)
+    return;
+
+  CLockObject lock(m_mutex);
+  // the current channel, channels next to it in its groups, then all
+  // others by their distance to it. hidden channels never show up in Kodi
+  std::vector<uint64_t> epgIds;
+  std::set<uint64_t> queued;
+  auto add = [&] (unsigned int index)
+    {
+      const DvbChannel &channel = m_channels[index];
+      if (!channel.hidden && queued.insert(channel.epgId).second)
+        epgIds.push_back(channel.epgId);
+    };
+
+  DvbChannel *current = GetChannelById(m_currentChannel);
+  size_t origin = (current) ? current - m_channels.data() : 0;
+  if (current)
+  {
+    add(origin);
+    for (auto &group : m_groups)
+    {
+      if (group.hidden)
+        continue;
+      const std::vector<unsigned int> &members = group.channels;
+      auto pos = std::find(members.begin(), members.end(), origin);
+      if (pos == members.end())
+        continue;
+      size_t index = pos - members.begin();
+      for (size_t dist = 1; dist < members.size(); ++dist)
+      {
+        if (index + dist < members.size())
+          add(members[index + dist]);
+        if (index >= dist)
+          add(members[index - dist]);
+      }
+    }
+  }
+
+  // nearest in the table first
+  for (size_t dist = 0; dist < m_channels.size(); ++dist)
+  {
+    if (dist && origin >= dist)
+      add(origin - dist);
+    if (origin + dist < m_channels.size())
+      add(origin + dist);
+  }
+
+  m_epgPrefetcher->Queue(epgIds);
+}
+
+time_t Dvb::ParseDateTime(StringView date, bool iso8601)
+{
+  int year = 0, month = 0, day = 0, hour = 0, min = 0, sec = 0;
+
+  // iso8601: yyyymmddhhmmss, otherwise: dd.mm.yyyyhh:mm:ss
   if (iso8601)
-    sscanf(date.c_str(), "%04d%02d%02d%02d%02d%02d", &timeinfo.tm_year,
-        &timeinfo.tm_mon, &timeinfo.tm_mday, &timeinfo.tm_hour,
-        &timeinfo.tm_min, &timeinfo.tm_sec);
+  {
+    StringParser::ParseDigits(date,  0, 4, year);
+    StringParser::ParseDigits(date,  4, 2, month);
+    StringParser::ParseDigits(date,  6, 2, day);
+    StringParser::ParseDigits(date,  8, 2, hour);
+    StringParser::ParseDigits(date, 10, 2, min);
+    StringParser::ParseDigits(date, 12, 2, sec);
+  }
   else
-    sscanf(date.c_str(), "%02d.%02d.%04d%02d:%02d:%02d", &timeinfo.tm_mday,
-        &timeinfo.tm_mon, &timeinfo.tm_year, &timeinfo.tm_hour,
-        &timeinfo.tm_min, &timeinfo.tm_sec);
-  timeinfo.tm_mon  -= 1;
-  timeinfo.tm_year -= 1900;
-  timeinfo.tm_isdst = -1;
-
-  return mktime(&timeinfo);
+  {
+    StringParser::ParseDigits(date,  0, 2, day);
+    StringParser::ParseDigits(date,  3, 2, month);
+    StringParser::ParseDigits(date,  6, 4, year);
+    StringParser::ParseDigits(date, 10, 2, hour);
+    StringParser::ParseDigits(date, 13, 2, min);
+    StringParser::ParseDigits(date, 16, 2, sec);
+  }
+
+  return m_localTime.ToTime(year, month, day, hour, min, sec);
 }
 
 std::string Dvb::BuildURL(const char* path, ...)
@@ -3,12 +3,21 @@
 #ifndef PVR_DVBVIEWER_DVBDATA_H
 #define PVR_DVBVIEWER_DVBDATA_H
 
+#include "ChannelIds.h"
+#include "EpgCache.h"
+#include "EpgPrefetcher.h"
+#include "LocalTime.h"
+#include "LogoCache.h"
 #include "RecordingReader.h"
+#include "RecordingCache.h"
+#include "SmallVector.h"
+#include "Snapshot.h"
+#include "XmlStreamParser.h"
 #include "libXBMC_pvr.h"
 #include "p8-platform/threads/threads.h"
-#include <list>
 #include <map>
 #include <functional>
+#include <unordered_map>
 
 #define CHANNELDAT_HEADER_SIZE       (7)
 #define ENCRYPTED_FLAG               (1 << 0)
@@ -18,6 +27,25 @@
 #define ADDITIONAL_AUDIO_TRACK_FLAG  (1 << 7)
 #define DAY_SECS                     (24 * 60 * 60)
 #define DELPHI_DATE                  (25569)
+#define HTTP_TIMEOUT                 (10)
+#define HTTP_READ_SIZE               (64 * 1024)
+#define BULK_EPG_LIFETIME            (10 * 60)
+/* days before/after today to prefetch. matches Kodi's defaults */
+#define EPG_PREFETCH_PAST            (1)
+#define EPG_PREFETCH_FUTURE          (3)
+/* seconds between prefetch runs */
+#define EPG_PREFETCH_INTERVAL        (60 * 60)
+/* after a channel switch the backend is polled every EPG_POLL_INTERVAL
+ * seconds for fresh EPG data, but no longer than EPG_POLL_TIMEOUT seconds
+ */
+#define EPG_POLL_INTERVAL            (2)
+#define EPG_POLL_TIMEOUT             (30)
+/* seconds from the current hour on which are compared by the EPG digest */
+#define EPG_DIGEST_WINDOW            (6 * 60 * 60)
+/* concurrent channel logo downloads */
+#define LOGO_DOWNLOADS               (2)
+#define HASH_INIT                    (0xCBF29CE484222325ULL)
+#define RECORDINGS_URL               "api/recordings.html?utf8=1&images=1"
 
 // minimum version required
 #define RS_VERSION_MAJOR   1
@@ -41,8 +69,8 @@ public:
 
 public:
   /*!< @brief unique id passed to kodi's database.
-   * starts at 1 and increases by each channel regardless of hidden state.
-   * see FIXME for more details
+   * PVR_CHANNEL.UniqueId is uint32 but DVBViewer ids are uint64, so it's
+   * derived from the primary backend id. see ChannelIds
    */
   unsigned int id;
   /*!< @brief channel number on the frontend */
@@ -50,15 +78,33 @@ public:
   /*!< @brief list of backend ids (e.g AC3, other languages, ...).
    * the first entry is used for generating the stream url
    */
-  std::list<uint64_t> backendIds;
+  SmallVector<uint64_t, 2> backendIds;
   uint64_t epgId;
   std::string name;
   /*!< @brief name of the channel on the backend */
   std::string backendName;
   std::string logo;
+  /*!< @brief url of the logo on the backend. Not compared and not part of
+   * the snapshot
+   */
+  std::string logoURL;
   bool radio;
   bool hidden;
   bool encrypted;
+
+  /*!< @brief nothing Kodi knows about differs */
+  bool operator==(const DvbChannel &other) const
+  {
+    return (id == other.id && frontendNr == other.frontendNr
+        && backendIds == other.backendIds && epgId == other.epgId
+        && name == other.name && backendName == other.backendName
+        && logo == other.logo && radio == other.radio
+        && hidden == other.hidden && encrypted == other.encrypted);
+  }
+  bool operator!=(const DvbChannel &other) const
+  {
+    return !(*this == other);
+  }
 };
 
 class DvbGroup
@@ -67,11 +113,25 @@ public:
   std::string name;
   /*!< @brief name of the channel on the backend */
   std::string backendName;
-  std::list<DvbChannel *> channels;
+  /*!< @brief indexes into the channel table */
+  std::vector<unsigned int> channels;
   bool radio;
   bool hidden;
+
+  /*!< @brief members are only comparable if the channel tables are equal */
+  bool operator==(const DvbGroup &other) const
+  {
+    return (name == other.name && backendName == other.backendName
+        && channels == other.channels && radio == other.radio
+        && hidden == other.hidden);
+  }
+  bool operator!=(const DvbGroup &other) const
+  {
+    return !(*this == other);
+  }
 };
 
+/*!< @brief EPG event while parsing. stored as EpgStore::Event */
 class DvbEPGEntry
 {
 public:
@@ -81,7 +141,6 @@ public:
 
 public:
   unsigned int id;
-  DvbChannel *channel;
   std::string title;
   time_t start;
   time_t end;
@@ -184,7 +243,10 @@ public:
   std::map<std::string, unsigned int>::iterator group;
 };
 
-typedef std::vector<DvbChannel *> DvbChannels_t;
+/*!< @brief channel table. Pointers to channels are valid until the
+ * channel list changes
+ */
+typedef std::vector<DvbChannel> DvbChannels_t;
 typedef std::vector<DvbGroup> DvbGroups_t;
 typedef std::vector<DvbTimer> DvbTimers_t;
 
@@ -196,6 +258,10 @@ public:
   ~Dvb();
 
   bool IsConnected();
+  /*!< @brief channels, timers and recordings can be listed. Either we're
+   * connected or they've been restored from the snapshot
+   */
+  bool HasData();
 
   std::string GetBackendName();
   std::string GetBackendVersion();
@@ -220,25 +286,106 @@ public:
   bool GetRecordings(ADDON_HANDLE handle);
   bool DeleteRecording(const PVR_RECORDING &recinfo);
   unsigned int GetRecordingsAmount();
+  /*!< @brief started reader of the recording. nullptr on failure */
   RecordingReader *OpenRecordedStream(const PVR_RECORDING &recinfo);
+  void CloseRecordedStream();
+  /*!< @brief queue a recording for download into the local cache */
+  bool CacheRecording(const PVR_RECORDING &recinfo);
 
   bool OpenLiveStream(const PVR_CHANNEL &channelinfo);
   void CloseLiveStream();
   const std::string GetLiveStreamURL(const PVR_CHANNEL &channelinfo);
 
+  /*!< @brief url without user:pass for logging and as the logo cache key */
+  static std::string StripCredentials(const std::string& url);
+
 protected:
   virtual void *Process(void) override;
 
 private:
   // functions
-  struct httpResponse { bool error; std::string content; };
-  httpResponse GetHttpXML(const std::string& url);
+  struct httpResponse
+  {
+    /*!< @brief transport failure or non 2xx status code */
+    bool error;
+    /*!< @brief http status code. 0 if the backend didn't respond at all */
+    int code;
+    /*!< @brief content didn't change since the last request */
+    bool unchanged;
+    std::string content;
+    /*!< @brief selected response headers. names are lowercase */
+    std::map<std::string, std::string> headers;
+  };
+  /*!< @brief state of the last response of an endpoint to detect changes */
+  struct httpValidator
+  {
+    std::string etag;
+    std::string lastModified;
+    /*!< @brief hash of the body in case the backend doesn't send any */
+    uint64_t hash;
+  };
+  /*!< @brief validator is optional. timeout for establishing the connection
+   * is in seconds. If a parser is passed the body is fed into it instead of
+   * being returned as content
+   */
+  httpResponse GetHttpXML(const std::string& url,
+      httpValidator *validator = nullptr, unsigned int timeout = HTTP_TIMEOUT,
+      XmlStreamParser *parser = nullptr);
+  uint64_t HashContent(uint64_t hash, const char *data, size_t size);
+  bool RecordingsChanged();
   std::string URLEncode(const std::string& data);
   bool LoadChannels();
-  DvbTimers_t LoadTimers();
+  /*!< @brief keep the previous channels and groups if nothing has changed.
+   * Otherwise notify Kodi
+   */
+  void ChannelsLoaded(DvbChannels_t &oldChannels, DvbGroups_t &oldGroups);
+  /*!< @brief hand Kodi the local copies of the logos
+   * @return true if a logo changed
+   */
+  bool UpdateLogos();
+  /*!< @brief rebuild the lookup indexes of m_channels */
+  void IndexChannels();
+  /*!< @brief restore the state of the last session */
+  bool LoadSnapshot();
+  void SaveSnapshot();
+  DvbTimers_t LoadTimers(bool &unchanged);
+  /*!< @brief entries of [start, end] from the backend */
+  bool FetchEPG(uint64_t epgId, time_t start, time_t end, EpgStore &events);
+  /*!< @brief serve the channel from a request for all channels
+   * @return false if the channel has to be fetched on its own
+   */
+  bool FetchBulkEPG(uint64_t epgId, time_t start, time_t end,
+      EpgStore &events);
+  /*!< @brief warm the EPG cache of a channel. runs on the prefetch workers */
+  void PrefetchEPG(uint64_t epgId);
+  /*!< @brief queue all channels for prefetching, most relevant first */
+  void QueueEPGPrefetch();
+  /*!< @brief parser callback adding the programme entries to events. The
+   * response is parsed as it arrives, so it's never kept in memory
+   */
+  XmlStreamParser::EntryFunc_t EPGEntryFunc(EpgStore &events);
+  bool ParseEPGEntry(const XmlElement &xEntry, DvbEPGEntry &entry);
+  /*!< @brief hash of the events overlapping [start, end] */
+  uint64_t EPGDigest(const EpgStore &events, time_t start, time_t end);
+  /*!< @brief remember the digest of the events transferred to Kodi */
+  void StoreEPGDigest(uint64_t epgId, const EpgStore &events, time_t start,
+      time_t end);
+  /*!< @brief cheap check whether the backend has different EPG data than
+   * Kodi got the last time. Without a digest of the current window the
+   * cached data is the reference. If there is none either, this reports a
+   * change once
+   */
+  bool EPGChanged(uint64_t epgId);
   void TimerUpdates();
-  DvbChannel *GetChannel(std::function<bool (const DvbChannel*)> func);
+  /*!< @brief channel of a Kodi channel id. nullptr if unknown */
+  DvbChannel *GetChannelById(unsigned int id);
+  /*!< @brief channel owning the (sub)channel id. nullptr if unknown */
+  DvbChannel *GetChannelByBackendId(uint64_t backendId);
+  /*!< @brief first channel with the name on the backend */
+  DvbChannel *GetChannelByBackendName(const std::string &backendName);
   DvbTimer *GetTimer(std::function<bool (const DvbTimer&)> func);
+  /*!< @brief end of the timer still recording recinfo. 0 if it's finished */
+  time_t RecordingEnd(const PVR_RECORDING &recinfo);
 
   // helper functions
   void RemoveNullChars(std::string& str);
@@ -246,11 +393,14 @@ private:
   bool UpdateBackendStatus(bool updateSettings = false);
   void SetConnectionState(PVR_CONNECTION_STATE state,
       const char *message = nullptr, ...);
-  time_t ParseDateTime(const std::string& strDate, bool iso8601 = true);
+  time_t ParseDateTime(StringView date, bool iso8601 = true);
   std::string BuildURL(const char* path, ...);
   std::string BuildExtURL(const std::string& baseURL, const char* path, ...);
   std::string ConvertToUtf8(const std::string& src);
   long GetGMTOffset();
+  /*!< @brief map the backend file of a recording to the local mount */
+  bool GetLocalRecordingPath(const std::string &recordingId,
+      std::string &path);
 
 private:
   PVR_CONNECTION_STATE m_state;
@@ -265,6 +415,11 @@ private:
   DvbChannels_t m_channels;
   /* active (not hidden) channels */
   unsigned int m_channelAmount;
+  /* indexes into m_channels. rebuilt by LoadChannels */
+  std::unordered_map<unsigned int, unsigned int> m_channelsById;
+  std::unordered_map<uint64_t, unsigned int> m_channelsByBackendId;
+  std::unordered_map<std::string, unsigned int> m_channelsByBackendName;
+  ChannelIds m_channelIds;
   unsigned int m_currentChannel;
 
   /* channel groups */
@@ -274,11 +429,54 @@ private:
 
   bool m_updateTimers;
   bool m_updateEPG;
+  /*!< @brief the logo cache has downloaded new logos */
+  bool m_updateLogos;
   unsigned int m_recordingAmount;
+  /*!< @brief recording id -> file on the backend */
+  std::map<std::string, std::string> m_recordingFiles;
+  httpValidator m_recordingsValidator;
+  /*!< @brief list fetched by the periodic change check */
+  std::string m_recordingsContent;
+  httpValidator m_timersValidator;
+
+  /*!< @brief optional local copies of recordings */
+  RecordingCache *m_recordingCache;
+  /*!< @brief optional persistent EPG store */
+  EpgCache *m_epgCache;
+  EpgPrefetcher *m_epgPrefetcher;
+  /*!< @brief local copies of the channel logos */
+  LogoCache *m_logoCache;
+  /*!< @brief result of the last bulk EPG request. epgId -> indexes into
+   * m_bulkEPGStore. Channels are removed once they've been served
+   */
+  std::map<uint64_t, std::vector<uint32_t>> m_bulkEPG;
+  EpgStore m_bulkEPGStore;
+  time_t m_bulkEPGStart, m_bulkEPGEnd;
+  /*!< @brief time of the last bulk request, whether it succeeded or not */
+  time_t m_bulkEPGFetched;
+  /*!< @brief false if the backend can't do bulk requests */
+  bool m_bulkEPGSupported;
+  struct EpgDigest
+  {
+    /*!< @brief start of the window of EPG_DIGEST_WINDOW seconds */
+    time_t start;
+    uint64_t digest;
+  };
+  /*!< @brief epgId -> digest of the last transferred or polled events */
+  std::map<uint64_t, EpgDigest> m_epgDigests;
+  httpValidator m_epgPollValidator;
+  P8PLATFORM::CMutex m_epgMutex;
+
+  /*!< @brief cached timezone offsets for ParseDateTime */
+  LocalTime m_localTime;
 
   DvbTimers_t m_timers;
   unsigned int m_nextTimerId;
 
+  Snapshot m_snapshot;
+  /*!< @brief serving the snapshot until the backend is reachable */
+  bool m_hasSnapshot;
+
   P8PLATFORM::CMutex m_mutex;
 };
 
@@ -0,0 +1,297 @@
+#include "EpgCache.h"
+#include "BinaryStream.h"
+#include "client.h"
+#include "p8-platform/util/StringUtils.h"
+#include <algorithm>
+#include <set>
+#include <inttypes.h>
+
+#define EPG_MAGIC         "DVBEPG02"
+/* entries which ended longer ago are dropped (s). matches Kodi's maximum
+ * of past days to display
+ */
+#define EPG_KEEP_PAST     (7 * 86400)
+/* channels kept in memory */
+#define EPG_CACHE_CHANNELS 16
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+using namespace BinaryStream;
+
+EpgCache::EpgCache(const std::string &path, time_t ttl)
+  : m_path(path), m_ttl(ttl)
+{
+}
+
+EpgCache::~EpgCache(void)
+{
+  for (auto channel : m_channels)
+    delete channel;
+}
+
+EpgCache::ChannelLock::ChannelLock(EpgCache &cache, uint64_t epgId)
+  : m_cache(cache), m_channel(cache.Acquire(epgId))
+{
+  m_channel->mutex.Lock();
+  if (m_channel->loaded)
+    return;
+  m_channel->loaded = true;
+  if (m_cache.Load(*m_channel))
+    XBMC->Log(LOG_DEBUG, "EpgCache: Loaded %u entries for %" PRIu64,
+        m_channel->events.Size(), epgId);
+}
+
+EpgCache::ChannelLock::~ChannelLock(void)
+{
+  m_channel->mutex.Unlock();
+  m_cache.Release(m_channel);
+}
+
+std::vector<EpgCache::Window_t> EpgCache::Missing(uint64_t epgId,
+    time_t start, time_t end)
+{
+  ChannelLock channel(*this, epgId);
+
+  // windows are sorted and don't overlap
+  std::vector<Window_t> missing;
+  time_t now = time(NULL), pos = start;
+  for (auto &window : channel->windows)
+  {
+    if (window.fetched + m_ttl <= now || window.end <= pos)
+      continue;
+    if (window.start >= end)
+      break;
+    if (window.start > pos)
+      missing.push_back(Window_t(pos, window.start));
+    pos = window.end;
+  }
+  if (pos < end)
+    missing.push_back(Window_t(pos, end));
+  return missing;
+}
+
+void EpgCache::Store(uint64_t epgId, const Window_t &window,
+    const EpgStore &events)
+{
+  ChannelLock channel(*this, epgId);
+
+  // whatever the backend didn't return for this window is gone. the store
+  // is rebuilt, so replaced texts don't stay in its arena
+  time_t now = time(NULL), cutoff = now - EPG_KEEP_PAST;
+  std::set<unsigned int> fetchedIds;
+  for (auto &event : events.Events())
+    fetchedIds.insert(event.id);
+
+  typedef std::pair<const EpgStore *, const EpgStore::Event *> Source_t;
+  std::vector<Source_t> merged;
+  const EpgStore &cached = channel->events;
+  for (auto &event : cached.Events())
+  {
+    if ((event.start >= window.first && event.end <= window.second)
+        || event.end < cutoff || fetchedIds.count(event.id))
+      continue;
+    merged.push_back(Source_t(&cached, &event));
+  }
+  for (auto &event : events.Events())
+    merged.push_back(Source_t(&events, &event));
+  std::stable_sort(merged.begin(), merged.end(),
+      [] (const Source_t &a, const Source_t &b)
+      {
+        return a.second->start < b.second->start;
+      });
+
+  EpgStore store;
+  store.Reserve(merged.size());
+  for (auto &source : merged)
+    store.Add(*source.first, *source.second);
+  store.Compact();
+  channel->events = std::move(store);
+
+  // the new window replaces overlapping parts of older ones
+  std::vector<FetchedWindow> windows;
+  for (auto &old : channel->windows)
+  {
+    if (old.end <= window.first || old.start >= window.second)
+    {
+      windows.push_back(old);
+      continue;
+    }
+    if (old.start < window.first)
+      windows.push_back({ old.start, window.first, old.fetched });
+    if (old.end > window.second)
+      windows.push_back({ window.second, old.end, old.fetched });
+  }
+  windows.push_back({ window.first, window.second, now });
+  std::sort(windows.begin(), windows.end(),
+      [] (const FetchedWindow &a, const FetchedWindow &b)
+      {
+        return a.start < b.start;
+      });
+  channel->windows.swap(windows);
+
+  Prune(*channel, now);
+  Save(*channel);
+}
+
+void EpgCache::Get(uint64_t epgId, time_t start, time_t end,
+    EpgStore &events)
+{
+  ChannelLock channel(*this, epgId);
+
+  events.Clear();
+  const EpgStore &cached = channel->events;
+  for (auto &event : cached.Events())
+  {
+    if (event.end <= start || event.start >= end)
+      continue;
+    events.Add(cached, event);
+  }
+}
+
+void EpgCache::Invalidate(uint64_t epgId)
+{
+  ChannelLock channel(*this, epgId);
+  channel->windows.clear();
+  Save(*channel);
+}
+
+EpgCache::Channel *EpgCache::Acquire(uint64_t epgId)
+{
+  CLockObject lock(m_mutex);
+  auto it = std::find_if(m_channels.begin(), m_channels.end(),
+      [epgId] (const Channel *channel)
+      {
+        return channel->epgId == epgId;
+      });
+  Channel *channel;
+  if (it != m_channels.end())
+  {
+    channel = *it;
+    m_channels.splice(m_channels.begin(), m_channels, it);
+  }
+  else
+  {
+    channel = new Channel();
+    channel->epgId  = epgId;
+    channel->loaded = false;
+    channel->users  = 0;
+    m_channels.push_front(channel);
+  }
+  ++channel->users;
+
+  // everything has been saved already. just forget the oldest ones
+  for (auto victim = m_channels.end(); m_channels.size() > EPG_CACHE_CHANNELS
+      && victim != m_channels.begin();)
+  {
+    --victim;
+    if ((*victim)->users)
+      continue;
+    delete *victim;
+    victim = m_channels.erase(victim);
+  }
+  return channel;
+}
+
+void EpgCache::Release(Channel *channel)
+{
+  CLockObject lock(m_mutex);
+  --channel->users;
+}
+
+bool EpgCache::Load(Channel &channel)
+{
+  std::vector<char> content;
+  if (!LoadFile(FileName(channel.epgId), content))
+    return false;
+
+  Reader reader(content);
+  uint32_t count;
+  if (!reader.ReadMagic(EPG_MAGIC) || !reader.Read(count))
+    return false;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    int64_t start, end, fetched;
+    if (!reader.Read(start) || !reader.Read(end) || !reader.Read(fetched))
+      return false;
+    channel.windows.push_back({ static_cast<time_t>(start),
+        static_cast<time_t>(end), static_cast<time_t>(fetched) });
+  }
+
+  if (!reader.Read(count))
+    return false;
+  channel.events.Reserve(count);
+  std::string title, plotOutline, plot;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    uint32_t id, genre;
+    int64_t start, end;
+    if (!reader.Read(id) || !reader.Read(start) || !reader.Read(end)
+        || !reader.Read(genre) || !reader.ReadString(title)
+        || !reader.ReadString(plotOutline) || !reader.ReadString(plot))
+    {
+      // don't trust the windows of a damaged file
+      channel.windows.clear();
+      return false;
+    }
+    channel.events.Add(id, static_cast<time_t>(start),
+        static_cast<time_t>(end), genre, title, plotOutline, plot);
+  }
+  channel.events.Compact();
+  return true;
+}
+
+bool EpgCache::Save(const Channel &channel)
+{
+  if (!XBMC->DirectoryExists(m_path.c_str())
+      && !XBMC->CreateDirectory(m_path.c_str()))
+    return false;
+
+  std::string file = FileName(channel.epgId);
+  void *fileHandle = XBMC->OpenFileForWrite(file.c_str(), true);
+  if (!fileHandle)
+  {
+    XBMC->Log(LOG_ERROR, "EpgCache: Unable to write %s", file.c_str());
+    return false;
+  }
+
+  std::vector<char> content(EPG_MAGIC, EPG_MAGIC + strlen(EPG_MAGIC));
+  Append<uint32_t>(content, channel.windows.size());
+  for (auto &window : channel.windows)
+  {
+    Append<int64_t>(content, window.start);
+    Append<int64_t>(content, window.end);
+    Append<int64_t>(content, window.fetched);
+  }
+  const EpgStore &events = channel.events;
+  Append<uint32_t>(content, events.Size());
+  for (auto &event : events.Events())
+  {
+    Append<uint32_t>(content, event.id);
+    Append<int64_t>(content, event.start);
+    Append<int64_t>(content, event.end);
+    Append<uint32_t>(content, event.genre);
+    AppendString(content, events.Text(event.title));
+    AppendString(content, events.Text(event.plotOutline));
+    AppendString(content, events.Text(event.plot));
+  }
+  XBMC->WriteFile(fileHandle, content.data(), content.size());
+  XBMC->CloseFile(fileHandle);
+  return true;
+}
+
+void EpgCache::Prune(Channel &channel, time_t now)
+{
+  // old entries are dropped while merging in Store
+  time_t cutoff = now - EPG_KEEP_PAST;
+  auto &windows = channel.windows;
+  windows.erase(std::remove_if(windows.begin(), windows.end(),
+        [&] (const FetchedWindow &window)
+        {
+          return (window.end < cutoff || window.fetched + m_ttl <= now);
+        }), windows.end());
+}
+
+std::string EpgCache::FileName(uint64_t epgId)
+{
+  return StringUtils::Format("%s/%" PRIu64 ".epg", m_path.c_str(), epgId);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_EPGCACHE_H
+#define PVR_DVBVIEWER_EPGCACHE_H
+
+#include "EpgStore.h"
+#include "p8-platform/threads/mutex.h"
+#include <ctime>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*!< @brief persistent per channel EPG store. It remembers which time
+ * windows have been fetched from the backend, so only windows which
+ * aren't covered or have expired need to be fetched again. The most
+ * recently used channels stay in memory. Each has its own lock, so
+ * different channels can be used concurrently
+ */
+class EpgCache
+{
+public:
+  typedef std::pair<time_t, time_t> Window_t;
+
+  /*!< @param ttl lifetime of fetched windows in seconds */
+  EpgCache(const std::string &path, time_t ttl);
+  ~EpgCache(void);
+  /*!< @brief parts of [start, end] which have to be fetched */
+  std::vector<Window_t> Missing(uint64_t epgId, time_t start, time_t end);
+  /*!< @brief replace the entries of a window with the ones just fetched */
+  void Store(uint64_t epgId, const Window_t &window,
+      const EpgStore &events);
+  /*!< @brief events overlapping [start, end] sorted by start time */
+  void Get(uint64_t epgId, time_t start, time_t end, EpgStore &events);
+  /*!< @brief force a refetch of a channel */
+  void Invalidate(uint64_t epgId);
+
+private:
+  struct FetchedWindow
+  {
+    time_t start, end;
+    time_t fetched;
+  };
+
+  struct Channel
+  {
+    uint64_t epgId;
+    bool loaded;
+    /*!< @brief references held. channels in use are never evicted */
+    unsigned int users;
+    std::vector<FetchedWindow> windows;
+    /*!< @brief sorted by start time. event ids are unique */
+    EpgStore events;
+    P8PLATFORM::CMutex mutex;
+  };
+
+  /*!< @brief exclusive access to a channel. It's loaded from disk on first
+   * use. File access happens under the lock of the channel only
+   */
+  class ChannelLock
+  {
+  public:
+    ChannelLock(EpgCache &cache, uint64_t epgId);
+    ~ChannelLock(void);
+    Channel *operator->() { return m_channel; }
+    Channel &operator*() { return *m_channel; }
+
+  private:
+    EpgCache &m_cache;
+    Channel *m_channel;
+  };
+
+  /*!< @brief reference to a channel in memory. Evicts the least recently
+   * used channels which aren't in use
+   */
+  Channel *Acquire(uint64_t epgId);
+  void Release(Channel *channel);
+  bool Load(Channel &channel);
+  bool Save(const Channel &channel);
+  /*!< @brief drop windows which are too old or have expired */
+  void Prune(Channel &channel, time_t now);
+  std::string FileName(uint64_t epgId);
+
+  std::string m_path;
+  time_t m_ttl;
+  /*!< @brief channels in memory. most recently used first */
+  std::list<Channel *> m_channels;
+  P8PLATFORM::CMutex m_mutex;
+};
+
+#endif
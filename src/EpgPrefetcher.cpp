@@ -0,0 +1,82 @@
+#include "EpgPrefetcher.h"
+#include "client.h"
+#include "p8-platform/threads/threads.h"
+
+/* workers wake up at least this often to check for a stop request (ms) */
+#define IDLE_INTERVAL 1000
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+class EpgPrefetcher::Worker
+  : public CThread
+{
+public:
+  Worker(EpgPrefetcher &owner)
+    : m_owner(owner)
+  {}
+
+private:
+  virtual void *Process(void) override
+  {
+    while (!IsStopped())
+    {
+      uint64_t epgId;
+      if (m_owner.Next(epgId))
+        m_owner.m_fetchFunc(epgId);
+      else
+        m_owner.m_event.Wait(IDLE_INTERVAL);
+    }
+    return nullptr;
+  }
+
+  EpgPrefetcher &m_owner;
+};
+
+EpgPrefetcher::EpgPrefetcher(unsigned int workers, FetchFunc_t fetchFunc)
+  : m_fetchFunc(fetchFunc)
+{
+  for (unsigned int i = 0; i < workers; ++i)
+  {
+    Worker *worker = new Worker(*this);
+    worker->CreateThread();
+    m_workers.push_back(worker);
+  }
+}
+
+EpgPrefetcher::~EpgPrefetcher(void)
+{
+  Clear();
+  for (auto worker : m_workers)
+    worker->StopThread(-1);
+  m_event.Broadcast();
+  for (auto worker : m_workers)
+  {
+    worker->StopThread();
+    delete worker;
+  }
+}
+
+void EpgPrefetcher::Queue(const std::vector<uint64_t> &epgIds)
+{
+  CLockObject lock(m_mutex);
+  m_queue.assign(epgIds.begin(), epgIds.end());
+  XBMC->Log(LOG_DEBUG, "EpgPrefetcher: Queued %u channels", m_queue.size());
+  m_event.Broadcast();
+}
+
+void EpgPrefetcher::Clear()
+{
+  CLockObject lock(m_mutex);
+  m_queue.clear();
+}
+
+bool EpgPrefetcher::Next(uint64_t &epgId)
+{
+  CLockObject lock(m_mutex);
+  if (m_queue.empty())
+    return false;
+  epgId = m_queue.front();
+  m_queue.pop_front();
+  return true;
+}
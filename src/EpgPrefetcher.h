@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_EPGPREFETCHER_H
+#define PVR_DVBVIEWER_EPGPREFETCHER_H
+
+#include "p8-platform/threads/mutex.h"
+#include <deque>
+#include <functional>
+#include <vector>
+#include <stdint.h>
+
+/*!< @brief pool of background workers warming the EPG cache. The amount of
+ * workers is the limit of concurrent requests to the backend
+ */
+class EpgPrefetcher
+{
+public:
+  typedef std::function<void (uint64_t epgId)> FetchFunc_t;
+
+  EpgPrefetcher(unsigned int workers, FetchFunc_t fetchFunc);
+  ~EpgPrefetcher(void);
+  /*!< @brief replace the pending channels. they're fetched in order */
+  void Queue(const std::vector<uint64_t> &epgIds);
+  /*!< @brief drop pending channels e.g. on disconnect */
+  void Clear();
+
+private:
+  class Worker;
+
+  /*!< @return false if there's nothing to do */
+  bool Next(uint64_t &epgId);
+
+  FetchFunc_t m_fetchFunc;
+  std::vector<Worker *> m_workers;
+  std::deque<uint64_t> m_queue;
+  P8PLATFORM::CMutex m_mutex;
+  P8PLATFORM::CEvent m_event;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "EpgStore.h"
+#include <cstring>
+
+#define TITLE_BUCKETS (64)
+
+size_t EpgStore::TitleHash::operator()(uint32_t offset) const
+{
+  // FNV-1a
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (const char *p = store->Text(offset); *p; ++p)
+    hash = (hash ^ static_cast<unsigned char>(*p)) * 0x100000001B3ULL;
+  return static_cast<size_t>(hash);
+}
+
+bool EpgStore::TitleEqual::operator()(uint32_t a, uint32_t b) const
+{
+  return (strcmp(store->Text(a), store->Text(b)) == 0);
+}
+
+EpgStore::EpgStore()
+  : m_titles(TITLE_BUCKETS, TitleHash{ this }, TitleEqual{ this })
+{
+  Clear();
+}
+
+EpgStore::EpgStore(EpgStore &&other)
+  : m_titles(TITLE_BUCKETS, TitleHash{ this }, TitleEqual{ this })
+{
+  *this = std::move(other);
+}
+
+EpgStore &EpgStore::operator=(EpgStore &&other)
+{
+  // the title index refers to its owner. rebuild it instead of moving
+  m_events.swap(other.m_events);
+  m_arena.swap(other.m_arena);
+  m_titles.clear();
+  for (uint32_t offset : other.m_titles)
+    m_titles.insert(offset);
+  other.Clear();
+  return *this;
+}
+
+void EpgStore::Clear()
+{
+  // offset 0 is the empty string
+  m_events.clear();
+  m_arena.assign(1, '\0');
+  m_titles.clear();
+}
+
+void EpgStore::Reserve(size_t events)
+{
+  m_events.reserve(events);
+}
+
+void EpgStore::Compact()
+{
+  m_events.shrink_to_fit();
+  m_arena.shrink_to_fit();
+}
+
+void EpgStore::Add(uint32_t id, time_t start, time_t end,
+    unsigned int genre, StringView title, StringView plotOutline,
+    StringView plot)
+{
+  Event event;
+  event.start       = start;
+  event.end         = end;
+  event.id          = id;
+  event.genre       = genre;
+  event.title       = Intern(title);
+  event.plotOutline = Append(plotOutline);
+  event.plot        = Append(plot);
+  m_events.push_back(event);
+}
+
+void EpgStore::Add(const EpgStore &other, const Event &event)
+{
+  Add(event.id, event.start, event.end, event.genre,
+      other.Text(event.title), other.Text(event.plotOutline),
+      other.Text(event.plot));
+}
+
+size_t EpgStore::MemoryUsage() const
+{
+  // a node holds the offset and the next pointer plus the cached hash
+  return m_events.capacity() * sizeof(Event) + m_arena.capacity()
+    + m_titles.bucket_count() * sizeof(void *)
+    + m_titles.size() * (sizeof(uint32_t) + sizeof(void *) + sizeof(size_t));
+}
+
+uint32_t EpgStore::Append(StringView text)
+{
+  if (text.empty())
+    return 0;
+  uint32_t offset = m_arena.size();
+  m_arena.insert(m_arena.end(), text.begin(), text.end());
+  m_arena.push_back('\0');
+  return offset;
+}
+
+uint32_t EpgStore::Intern(StringView title)
+{
+  if (title.empty())
+    return 0;
+  // the lookup needs the title inside the arena. drop it again on a hit
+  uint32_t offset = Append(title);
+  auto it = m_titles.insert(offset);
+  if (!it.second)
+    m_arena.resize(offset);
+  return *it.first;
+}
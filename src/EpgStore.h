@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_EPGSTORE_H
+#define PVR_DVBVIEWER_EPGSTORE_H
+
+#include "StringView.h"
+#include <ctime>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <stdint.h>
+
+/*!< @brief compact EPG storage. Events are fixed size records in a
+ * contiguous array. Their texts live in a single arena; titles are
+ * interned as they repeat a lot (news, series, ...)
+ */
+class EpgStore
+{
+public:
+  struct Event
+  {
+    int64_t start, end;
+    uint32_t id;
+    uint32_t genre;
+    /* offsets into the arena. texts are NUL terminated */
+    uint32_t title, plotOutline, plot;
+  };
+
+  EpgStore();
+  EpgStore(const EpgStore &other) = delete;
+  EpgStore &operator=(const EpgStore &other) = delete;
+  EpgStore(EpgStore &&other);
+  EpgStore &operator=(EpgStore &&other);
+  void Clear();
+  void Reserve(size_t events);
+  /*!< @brief release unused capacity once the store is complete */
+  void Compact();
+  void Add(uint32_t id, time_t start, time_t end, unsigned int genre,
+      StringView title, StringView plotOutline, StringView plot);
+  /*!< @brief copy an event of another store */
+  void Add(const EpgStore &other, const Event &event);
+
+  const std::vector<Event> &Events() const { return m_events; }
+  size_t Size() const { return m_events.size(); }
+  bool Empty() const { return m_events.empty(); }
+  const char *Text(uint32_t offset) const { return &m_arena[offset]; }
+  /*!< @brief approximate heap usage in bytes */
+  size_t MemoryUsage() const;
+
+private:
+  /*!< @brief hashes and compares titles by their arena offset */
+  struct TitleHash
+  {
+    const EpgStore *store;
+    size_t operator()(uint32_t offset) const;
+  };
+  struct TitleEqual
+  {
+    const EpgStore *store;
+    bool operator()(uint32_t a, uint32_t b) const;
+  };
+
+  uint32_t Append(StringView text);
+  uint32_t Intern(StringView title);
+
+  std::vector<Event> m_events;
+  std::vector<char> m_arena;
+  /*!< @brief arena offsets of the interned titles. titles aren't stored twice */
+  std::unordered_set<uint32_t, TitleHash, TitleEqual> m_titles;
+};
+
+#endif
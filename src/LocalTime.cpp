@@ -0,0 +1,106 @@
+#include "LocalTime.h"
+#include <algorithm>
+
+using namespace P8PLATFORM;
+
+time_t LocalTime::ToTime(int year, int month, int day, int hour, int min,
+    int sec)
+{
+  // out of range months and days and times are normalized linearly, just
+  // like mktime does
+  int64_t months = static_cast<int64_t>(year) * 12 + month - 1;
+  int64_t years = (months >= 0) ? months / 12 : (months - 11) / 12;
+  int64_t local = DaysFromCivil(years, static_cast<int>(months - years * 12) + 1,
+      day) * 86400 + hour * 3600 + min * 60 + sec;
+  int64_t localHour = (local >= 0) ? local / 3600 : (local - 3599) / 3600;
+
+  long offset;
+  {
+    CLockObject lock(m_mutex);
+    offset = HourOffset(localHour);
+  }
+  if (offset == UNCACHEABLE)
+    return static_cast<time_t>(Resolve(local));
+  return static_cast<time_t>(local - offset);
+}
+
+void LocalTime::Reset()
+{
+  CLockObject lock(m_mutex);
+  m_offsets.clear();
+}
+
+long LocalTime::HourOffset(int64_t hour)
+{
+  auto it = m_offsets.find(hour);
+  if (it != m_offsets.end())
+    return it->second;
+
+  /* the offset is only cached if it's the same from the start of the
+   * previous hour up to the end of the next hour. everything closer to a
+   * transition (including skipped and repeated times) is resolved one by one
+   */
+  long offset = UNCACHEABLE;
+  int64_t probes[] = { (hour - 1) * 3600, hour * 3600, hour * 3600 + 3599,
+    (hour + 1) * 3600 + 3599 };
+  for (int64_t probe : probes)
+  {
+    long probeOffset = static_cast<long>(probe - Resolve(probe));
+    if (offset != UNCACHEABLE && offset != probeOffset)
+    {
+      offset = UNCACHEABLE;
+      break;
+    }
+    offset = probeOffset;
+  }
+  m_offsets[hour] = offset;
+  return offset;
+}
+
+int64_t LocalTime::Resolve(int64_t local)
+{
+  /* candidates are the offsets in effect a day before and after. assumes
+   * there's no more than one transition in between
+   */
+  long before = Offset(local - 86400), after = Offset(local + 86400);
+  int64_t first = local - before, second = local - after;
+  bool firstValid  = (Offset(first) == before);
+  bool secondValid = (Offset(second) == after);
+
+  if (firstValid && secondValid)
+    return std::min(first, second); // repeated. the first occurrence wins
+  if (secondValid)
+    return second;
+  // skipped times keep the offset from before the gap
+  return first;
+}
+
+long LocalTime::Offset(int64_t t)
+{
+  // localtime has no hidden state affecting later calls, unlike mktime
+  time_t tt = static_cast<time_t>(t);
+  struct tm tm;
+#ifdef TARGET_POSIX
+  if (!localtime_r(&tt, &tm))
+    return 0;
+#else
+  if (localtime_s(&tm, &tt) != 0)
+    return 0;
+#endif
+  int64_t local = DaysFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday)
+    * 86400 + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+  return static_cast<long>(local - t);
+}
+
+/* days since 1970-01-01 of the proleptic gregorian calendar. see
+ * http://howardhinnant.github.io/date_algorithms.html
+ */
+int64_t LocalTime::DaysFromCivil(int64_t year, int month, int day)
+{
+  year -= (month <= 2);
+  int64_t era = ((year >= 0) ? year : year - 399) / 400;
+  int64_t yoe = year - era * 400;
+  int64_t doy = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_LOCALTIME_H
+#define PVR_DVBVIEWER_LOCALTIME_H
+
+#include "p8-platform/threads/mutex.h"
+#include <climits>
+#include <ctime>
+#include <map>
+#include <stdint.h>
+
+/*!< @brief converts local date/time fields to time_t. Caches the UTC offset
+ * of every local hour, so most conversions are plain arithmetic. Unlike
+ * mktime with tm_isdst = -1 the result never depends on earlier calls:
+ * a repeated local time (end of DST) resolves to its first occurrence and
+ * a skipped one (start of DST) is moved forward by the length of the gap.
+ * All other times give the same results as mktime.
+ */
+class LocalTime
+{
+public:
+  time_t ToTime(int year, int month, int day, int hour, int min, int sec);
+  /*!< @brief forget the cached offsets e.g. after a timezone change */
+  void Reset();
+
+private:
+  /*!< @brief UTC offset of a local hour. UNCACHEABLE near transitions */
+  long HourOffset(int64_t hour);
+  /*!< @brief time_t of a local time given as seconds since the epoch */
+  static int64_t Resolve(int64_t local);
+  /*!< @brief UTC offset in effect at time t */
+  static long Offset(int64_t t);
+  static int64_t DaysFromCivil(int64_t year, int month, int day);
+
+  static const long UNCACHEABLE = LONG_MIN;
+
+  P8PLATFORM::CMutex m_mutex;
+  std::map<int64_t, long> m_offsets;
+};
+
+#endif
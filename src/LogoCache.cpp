@@ -0,0 +1,354 @@
+#include "LogoCache.h"
+#include "BinaryStream.h"
+#include "client.h"
+#include "p8-platform/threads/threads.h"
+#include "p8-platform/util/StringUtils.h"
+#include <cstdio>
+#include <cstring>
+
+#define LOGO_MAGIC        "DVBLOGO2"
+#define LOGO_INDEX        "index.dat"
+/* local copies are revalidated after this time (s) */
+#define LOGO_REVALIDATE   (7 * 86400)
+/* seconds to wait for the connection of a download */
+#define LOGO_TIMEOUT      (10)
+/* workers wake up at least this often to check for a stop request (ms) */
+#define IDLE_INTERVAL     1000
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+using namespace BinaryStream;
+
+class LogoCache::Worker
+  : public CThread
+{
+public:
+  Worker(LogoCache &owner)
+    : m_owner(owner)
+  {}
+
+private:
+  virtual void *Process(void) override
+  {
+    while (!IsStopped())
+    {
+      std::string key;
+      if (m_owner.Next(key))
+      {
+        m_owner.Fetch(key);
+        m_owner.Done(key);
+      }
+      else
+        m_owner.m_event.Wait(IDLE_INTERVAL);
+    }
+    return nullptr;
+  }
+
+  LogoCache &m_owner;
+};
+
+LogoCache::LogoCache(const std::string &path, unsigned int workers,
+    UpdatedFunc_t updatedFunc)
+  : m_path(path), m_updatedFunc(updatedFunc), m_busy(0),
+  m_changed(false)
+{
+  if (Load())
+    XBMC->Log(LOG_DEBUG, "LogoCache: Loaded %u logos", m_logos.size());
+
+  for (unsigned int i = 0; i < workers; ++i)
+  {
+    Worker *worker = new Worker(*this);
+    worker->CreateThread();
+    m_workers.push_back(worker);
+  }
+}
+
+LogoCache::~LogoCache(void)
+{
+  {
+    CLockObject lock(m_mutex);
+    m_queue.clear();
+  }
+  for (auto worker : m_workers)
+    worker->StopThread(-1);
+  m_event.Broadcast();
+  for (auto worker : m_workers)
+  {
+    worker->StopThread();
+    delete worker;
+  }
+}
+
+std::string LogoCache::Get(const std::string &key, const std::string &url)
+{
+  CLockObject lock(m_mutex);
+  m_urls[key] = url;
+  auto it = m_logos.find(key);
+  bool cached = (it != m_logos.end());
+  std::string file;
+  if (cached)
+  {
+    file = m_path + "/" + it->second.file;
+    // somebody cleaned up addon_data
+    if (!XBMC->FileExists(file.c_str(), false))
+    {
+      m_logos.erase(it);
+      cached = false;
+    }
+  }
+  if ((!cached || it->second.checked + LOGO_REVALIDATE <= time(NULL))
+      && m_pending.insert(key).second)
+  {
+    m_queue.push_back(key);
+    m_event.Broadcast();
+  }
+  return (cached) ? file : url;
+}
+
+void LogoCache::Prune(const std::set<std::string> &keys)
+{
+  CLockObject lock(m_mutex);
+  for (auto it = m_logos.begin(); it != m_logos.end(); )
+  {
+    if (keys.count(it->first))
+    {
+      ++it;
+      continue;
+    }
+    XBMC->Log(LOG_DEBUG, "LogoCache: Removing logo %s", it->first.c_str());
+    XBMC->DeleteFile((m_path + "/" + it->second.file).c_str());
+    m_urls.erase(it->first);
+    it = m_logos.erase(it);
+  }
+  Save();
+
+  // a worker might be writing a file which isn't in m_logos yet
+  if (m_busy)
+    return;
+  std::set<std::string> files;
+  for (auto &logo : m_logos)
+    files.insert(logo.second.file);
+  VFSDirEntry *items;
+  unsigned int count;
+  if (!XBMC->DirectoryExists(m_path.c_str())
+      || !XBMC->GetDirectory(m_path.c_str(), "", &items, &count))
+    return;
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    std::string name = items[i].label;
+    if (!items[i].folder && name != LOGO_INDEX && !files.count(name))
+      XBMC->DeleteFile(items[i].path);
+  }
+  XBMC->FreeDirectory(items, count);
+}
+
+bool LogoCache::Next(std::string &key)
+{
+  CLockObject lock(m_mutex);
+  if (m_queue.empty())
+    return false;
+  key = m_queue.front();
+  m_queue.pop_front();
+  ++m_busy;
+  return true;
+}
+
+void LogoCache::Fetch(const std::string &key)
+{
+  Logo logo = {};
+  std::string url;
+  bool cached;
+  {
+    CLockObject lock(m_mutex);
+    auto it = m_logos.find(key);
+    cached = (it != m_logos.end());
+    if (cached)
+      logo = it->second;
+    url = m_urls[key];
+  }
+  std::string oldFile = logo.file;
+
+  void *fileHandle = XBMC->CURLCreate(url.c_str());
+  if (!fileHandle)
+    return;
+  XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_PROTOCOL,
+      "failonerror", "false");
+  XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_PROTOCOL,
+      "connection-timeout", std::to_string(LOGO_TIMEOUT).c_str());
+  // usually the backend answers a revalidation with 304 and no body
+  if (cached && !logo.etag.empty())
+    XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER,
+        "If-None-Match", logo.etag.c_str());
+  if (cached && !logo.lastModified.empty())
+    XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER,
+        "If-Modified-Since", logo.lastModified.c_str());
+  if (!XBMC->CURLOpen(fileHandle, READ_NO_CACHE))
+  {
+    XBMC->CloseFile(fileHandle);
+    return;
+  }
+
+  int code = 0;
+  if (char *protocol = XBMC->GetFilePropertyValue(fileHandle,
+      XFILE::FILE_PROPERTY_RESPONSE_PROTOCOL, ""))
+  {
+    sscanf(protocol, "%*s %d", &code);
+    XBMC->FreeString(protocol);
+  }
+  if (code == 0)
+    code = 200;
+
+  for (auto header : { std::make_pair("etag", &logo.etag),
+      std::make_pair("last-modified", &logo.lastModified) })
+  {
+    char *value = XBMC->GetFilePropertyValue(fileHandle,
+        XFILE::FILE_PROPERTY_RESPONSE_HEADER, header.first);
+    if (!value)
+      continue;
+    if (*value)
+      *header.second = value;
+    XBMC->FreeString(value);
+  }
+
+  std::vector<char> content;
+  char buffer[4096];
+  while (ssize_t bytesRead = XBMC->ReadFile(fileHandle, buffer, sizeof(buffer)))
+  {
+    if (bytesRead < 0)
+      break;
+    content.insert(content.end(), buffer, buffer + bytesRead);
+  }
+  XBMC->CloseFile(fileHandle);
+
+  if (code != 304)
+  {
+    if (code < 200 || code >= 300 || content.empty())
+    {
+      XBMC->Log(LOG_DEBUG, "LogoCache: HTTP %d for logo %s", code,
+          key.c_str());
+      return;
+    }
+
+    // same content, same name. there's nothing to replace
+    logo.file = FileName(key, content);
+    std::string file = m_path + "/" + logo.file;
+    if (logo.file != oldFile || !XBMC->FileExists(file.c_str(), false))
+    {
+      if (!XBMC->DirectoryExists(m_path.c_str())
+          && !XBMC->CreateDirectory(m_path.c_str()))
+        return;
+      void *writeHandle = XBMC->OpenFileForWrite(file.c_str(), true);
+      if (!writeHandle)
+      {
+        XBMC->Log(LOG_ERROR, "LogoCache: Unable to write %s", file.c_str());
+        return;
+      }
+      XBMC->WriteFile(writeHandle, content.data(), content.size());
+      XBMC->CloseFile(writeHandle);
+    }
+  }
+
+  logo.checked = time(NULL);
+  CLockObject lock(m_mutex);
+  m_logos[key] = logo;
+  if (logo.file == oldFile)
+    return;
+  if (!oldFile.empty())
+    XBMC->DeleteFile((m_path + "/" + oldFile).c_str());
+  m_changed = true;
+}
+
+void LogoCache::Done(const std::string &key)
+{
+  bool notify = false;
+  {
+    CLockObject lock(m_mutex);
+    m_pending.erase(key);
+    if (--m_busy > 0 || !m_queue.empty())
+      return;
+    // the batch is complete
+    Save();
+    notify = m_changed;
+    m_changed = false;
+  }
+  if (notify)
+    m_updatedFunc();
+}
+
+std::string LogoCache::FileName(const std::string &key,
+    const std::vector<char> &content)
+{
+  // FNV-1a of the key keeps the name unique and free of special characters.
+  // the one of the content changes the name whenever the logo changes
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (unsigned char c : key)
+    hash = (hash ^ c) * 0x100000001B3ULL;
+  uint64_t version = 0xCBF29CE484222325ULL;
+  for (unsigned char c : content)
+    version = (version ^ c) * 0x100000001B3ULL;
+
+  std::string extension;
+  size_t pos = key.find_last_of("./");
+  if (pos != std::string::npos && key[pos] == '.' && key.size() - pos <= 5)
+  {
+    extension = key.substr(pos);
+    StringUtils::ToLower(extension);
+  }
+  return StringUtils::Format("%016llx-%08x%s",
+      static_cast<unsigned long long>(hash),
+      static_cast<unsigned int>(version ^ (version >> 32)), extension.c_str());
+}
+
+bool LogoCache::Load()
+{
+  std::vector<char> content;
+  if (!LoadFile(m_path + "/" LOGO_INDEX, content))
+    return false;
+
+  Reader reader(content);
+  uint32_t count;
+  if (!reader.ReadMagic(LOGO_MAGIC) || !reader.Read(count))
+    return false;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    std::string key;
+    Logo logo;
+    int64_t checked;
+    if (!reader.ReadString(key) || !reader.ReadString(logo.file)
+        || !reader.ReadString(logo.etag) || !reader.ReadString(logo.lastModified)
+        || !reader.Read(checked))
+      return false;
+    logo.checked = static_cast<time_t>(checked);
+    m_logos[key] = logo;
+  }
+  return true;
+}
+
+bool LogoCache::Save()
+{
+  if (!XBMC->DirectoryExists(m_path.c_str())
+      && !XBMC->CreateDirectory(m_path.c_str()))
+    return false;
+
+  std::string file = m_path + "/" LOGO_INDEX;
+  void *fileHandle = XBMC->OpenFileForWrite(file.c_str(), true);
+  if (!fileHandle)
+  {
+    XBMC->Log(LOG_ERROR, "LogoCache: Unable to write %s", file.c_str());
+    return false;
+  }
+
+  std::vector<char> content(LOGO_MAGIC, LOGO_MAGIC + strlen(LOGO_MAGIC));
+  Append<uint32_t>(content, m_logos.size());
+  for (auto &logo : m_logos)
+  {
+    AppendString(content, logo.first);
+    AppendString(content, logo.second.file);
+    AppendString(content, logo.second.etag);
+    AppendString(content, logo.second.lastModified);
+    Append<int64_t>(content, logo.second.checked);
+  }
+  XBMC->WriteFile(fileHandle, content.data(), content.size());
+  XBMC->CloseFile(fileHandle);
+  return true;
+}
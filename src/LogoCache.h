@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_LOGOCACHE_H
+#define PVR_DVBVIEWER_LOGOCACHE_H
+
+#include "p8-platform/threads/mutex.h"
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/*!< @brief local copies of the channel logos. Logos are downloaded by a
+ * few background workers and revalidated with conditional requests once
+ * in a while, so Kodi doesn't fetch them from the backend over and over.
+ * File names contain a hash of the content, so Kodi doesn't keep showing
+ * the texture of a replaced logo
+ */
+class LogoCache
+{
+public:
+  typedef std::function<void ()> UpdatedFunc_t;
+
+  /*!< @param updatedFunc called once downloads have finished and at least
+   * one logo was added or replaced
+   */
+  LogoCache(const std::string &path, unsigned int workers,
+      UpdatedFunc_t updatedFunc);
+  ~LogoCache(void);
+  /*!< @brief path of the logo to hand to Kodi. That's the local copy if
+   * there is one, otherwise the url. Missing and outdated logos are queued
+   * @param key url without credentials. It's stored on disk
+   * @param url url to download the logo from
+   */
+  std::string Get(const std::string &key, const std::string &url);
+  /*!< @brief forget the logos not in keys and delete their files */
+  void Prune(const std::set<std::string> &keys);
+
+private:
+  class Worker;
+
+  struct Logo
+  {
+    std::string file;
+    std::string etag, lastModified;
+    time_t checked;
+  };
+
+  /*!< @return false if there's nothing to do */
+  bool Next(std::string &key);
+  void Fetch(const std::string &key);
+  /*!< @brief a worker is done with key */
+  void Done(const std::string &key);
+  std::string FileName(const std::string &key,
+      const std::vector<char> &content);
+  bool Load();
+  bool Save();
+
+  std::string m_path;
+  UpdatedFunc_t m_updatedFunc;
+  std::vector<Worker *> m_workers;
+  /*!< @brief key -> local copy */
+  std::map<std::string, Logo> m_logos;
+  /*!< @brief key -> url to download from. kept in memory only */
+  std::map<std::string, std::string> m_urls;
+  std::deque<std::string> m_queue;
+  /*!< @brief keys queued or being downloaded */
+  std::set<std::string> m_pending;
+  /*!< @brief downloads in progress */
+  unsigned int m_busy;
+  /*!< @brief a logo has been added or replaced since the last notification */
+  bool m_changed;
+  P8PLATFORM::CMutex m_mutex;
+  P8PLATFORM::CEvent m_event;
+};
+
+#endif
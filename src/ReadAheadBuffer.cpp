@@ -0,0 +1,461 @@
+#include "ReadAheadBuffer.h"
+#include "client.h"
+#include "p8-platform/util/timeutils.h"
+#include <algorithm>
+#include <inttypes.h>
+
+#define READ_CHUNK_SIZE       65536
+#define SEGMENT_SIZE          (512 * 1024)
+#define BUFFER_READ_TIMEOUT   10000
+#define BUFFER_READ_WAITTIME  50
+#define FULL_WAIT_INTERVAL    100
+#define EOF_RETRY_INTERVAL    1000
+#define ADAPT_INTERVAL        2000
+/* consecutive failed ranges before switching to sequential reads for good */
+#define RANGE_MAX_FAILURES    3
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+/*!< @brief fetches a single byte range using its own connection */
+class ReadAheadBuffer::RangeWorker
+  : public P8PLATFORM::CThread
+{
+public:
+  RangeWorker(ReadAheadBuffer &owner, const std::string &url)
+    : m_owner(owner), m_url(url), m_handle(nullptr), m_busy(false)
+  {}
+
+  ~RangeWorker(void)
+  {
+    StopThread(-1);
+    m_jobEvent.Signal();
+    StopThread();
+    if (m_handle)
+      XBMC->CloseFile(m_handle);
+  }
+
+  bool IsBusy()
+  {
+    CLockObject lock(m_mutex);
+    return m_busy;
+  }
+
+  void Fetch(unsigned int generation, uint64_t offset, unsigned int size)
+  {
+    CLockObject lock(m_mutex);
+    m_generation = generation;
+    m_offset = offset;
+    m_size = size;
+    m_busy = true;
+    m_jobEvent.Signal();
+  }
+
+private:
+  virtual void *Process(void) override
+  {
+    while (!IsStopped())
+    {
+      if (!m_jobEvent.Wait(1000) || IsStopped())
+        continue;
+
+      m_mutex.Lock();
+      unsigned int generation = m_generation;
+      uint64_t offset = m_offset;
+      unsigned int size = m_size;
+      m_mutex.Unlock();
+
+      std::vector<unsigned char> data(size);
+      size_t got = 0;
+      if (!m_handle)
+        m_handle = XBMC->OpenFile(m_url.c_str(), READ_NO_CACHE);
+      if (m_handle && XBMC->SeekFile(m_handle, offset, SEEK_SET)
+          == static_cast<int64_t>(offset))
+      {
+        while (got < size && !IsStopped())
+        {
+          ssize_t read = XBMC->ReadFile(m_handle, &data[got], size - got);
+          if (read <= 0)
+            break;
+          got += read;
+        }
+      }
+
+      /* reconnect on next request */
+      if (got < size && m_handle)
+      {
+        XBMC->CloseFile(m_handle);
+        m_handle = nullptr;
+      }
+      data.resize(got);
+
+      m_mutex.Lock();
+      m_busy = false;
+      m_mutex.Unlock();
+      m_owner.OnSegment(generation, offset, data, size);
+    }
+    return nullptr;
+  }
+
+  ReadAheadBuffer &m_owner;
+  std::string m_url;
+  void *m_handle;
+
+  bool m_busy;
+  unsigned int m_generation;
+  uint64_t m_offset;
+  unsigned int m_size;
+  P8PLATFORM::CEvent m_jobEvent;
+  P8PLATFORM::CMutex m_mutex;
+};
+
+ReadAheadBuffer::ReadAheadBuffer(size_t size, ReadFunc_t readFunc,
+    SeekFunc_t seekFunc)
+  : m_readFunc(readFunc), m_seekFunc(seekFunc), m_ring(size), m_head(0),
+  m_used(0), m_readPos(0), m_fillPos(0), m_rawPos(0), m_generation(0),
+  m_eof(false), m_eofRetry(0), m_filling(false), m_rangeRequests(false),
+  m_rangeFailures(0), m_rangeStart(0), m_dispatchPos(0), m_sequentialEnd(0), m_inflight(0),
+  m_connections(1), m_windowStart(0), m_windowBytes(0),
+  m_windowSaturated(false), m_lastRate(0.0), m_direction(1)
+{
+  m_stats = { 0, 0, 0, 0, 0 };
+}
+
+ReadAheadBuffer::~ReadAheadBuffer(void)
+{
+  StopThread(-1);
+  m_spaceEvent.Signal();
+  StopThread();
+
+  for (auto worker : m_workers)
+    delete worker;
+}
+
+void ReadAheadBuffer::EnableRangeRequests(const std::string &url,
+    unsigned int maxConnections, uint64_t rangeStart, LengthFunc_t lengthFunc)
+{
+  /* we need room for at least two segments in flight */
+  if (IsRunning() || maxConnections < 2 || m_ring.size() < 2 * SEGMENT_SIZE)
+    return;
+
+  m_lengthFunc = lengthFunc;
+  m_rangeRequests = true;
+  m_rangeStart = rangeStart;
+  for (unsigned int i = 0; i < maxConnections; ++i)
+    m_workers.push_back(new RangeWorker(*this, url));
+}
+
+bool ReadAheadBuffer::Start(uint64_t position)
+{
+  if (m_ring.empty())
+    return false;
+  if (IsRunning())
+    return true;
+  m_readPos = m_fillPos = m_rawPos = m_dispatchPos = position;
+  m_windowStart = GetTimeMs();
+  for (auto worker : m_workers)
+    worker->CreateThread();
+  XBMC->Log(LOG_DEBUG, "ReadAhead: Started; size=%u, max connections=%u",
+      m_ring.size(), std::max<size_t>(m_workers.size(), 1));
+  CreateThread();
+  return true;
+}
+
+void *ReadAheadBuffer::Process()
+{
+  std::vector<unsigned char> chunk(std::min<size_t>(READ_CHUNK_SIZE,
+        m_ring.size()));
+
+  while (!IsStopped())
+  {
+    bool progress = (m_rangeRequests) ? FillParallel(chunk)
+      : FillSequential(chunk);
+    if (!progress)
+      m_spaceEvent.Wait(FULL_WAIT_INTERVAL);
+  }
+  return nullptr;
+}
+
+bool ReadAheadBuffer::FillSequential(std::vector<unsigned char> &chunk)
+{
+  m_mutex.Lock();
+  unsigned int generation = m_generation;
+  uint64_t fillPos = m_fillPos;
+  size_t space = m_ring.size() - m_used;
+
+  /* full or at the end. in the latter case retry from time to time as
+   * ongoing recordings will grow
+   */
+  if (!space || (m_eof && GetTimeMs() < m_eofRetry))
+  {
+    m_mutex.Unlock();
+    return false;
+  }
+  m_filling = true;
+  m_mutex.Unlock();
+
+  if (m_rawPos != fillPos)
+  {
+    m_seekFunc(fillPos);
+    m_rawPos = fillPos;
+  }
+
+  ssize_t read = m_readFunc(chunk.data(), std::min(space, chunk.size()));
+  if (read > 0)
+    m_rawPos += read;
+
+  CLockObject lock(m_mutex);
+  m_filling = false;
+  /* a seek happened in the meantime. throw the prefetched data away */
+  if (generation != m_generation)
+    return true;
+
+  if (read <= 0)
+  {
+    m_eof = true;
+    m_eofRetry = GetTimeMs() + EOF_RETRY_INTERVAL;
+    m_dataEvent.Signal();
+    return false;
+  }
+
+  Append(chunk.data(), read);
+  m_eof = false;
+  m_dataEvent.Signal();
+  return true;
+}
+
+bool ReadAheadBuffer::FillParallel(std::vector<unsigned char> &chunk)
+{
+  uint64_t length = m_lengthFunc();
+  bool progress = false;
+
+  CLockObject lock(m_mutex);
+  /* move completed segments into the ring in order */
+  for (auto it = m_segments.find(m_fillPos); it != m_segments.end();
+      it = m_segments.find(m_fillPos))
+  {
+    Segment &segment = it->second;
+    if (m_ring.size() - m_used < segment.data.size())
+      break;
+
+    Append(segment.data.data(), segment.data.size());
+    m_windowBytes += segment.data.size();
+    progress = true;
+
+    bool incomplete = segment.incomplete;
+    m_segments.erase(it);
+    if (incomplete)
+    {
+      /* connection failed or the range got rejected. read the failed range
+       * sequentially. give up on range requests if they keep failing
+       */
+      ++m_generation;
+      m_segments.clear();
+      m_dispatchPos = m_fillPos;
+      m_sequentialEnd = m_fillPos + SEGMENT_SIZE;
+      if (++m_rangeFailures >= RANGE_MAX_FAILURES)
+      {
+        XBMC->Log(LOG_NOTICE, "ReadAhead: %u range requests failed in a row. "
+            "Switching to sequential reads", m_rangeFailures);
+        m_rangeRequests = false;
+      }
+      break;
+    }
+    m_rangeFailures = 0;
+  }
+  if (progress)
+  {
+    m_eof = false;
+    m_dataEvent.Signal();
+  }
+
+  if (!m_rangeRequests)
+  {
+    lock.Unlock();
+    return FillSequential(chunk) || progress;
+  }
+
+  /* request further segments as long as they fit into the ring */
+  while (m_inflight < m_connections && m_dispatchPos >= m_rangeStart
+      && m_dispatchPos >= m_sequentialEnd
+      && m_dispatchPos + SEGMENT_SIZE <= length)
+  {
+    if (m_dispatchPos + SEGMENT_SIZE - m_readPos > m_ring.size())
+    {
+      m_windowSaturated = true;
+      break;
+    }
+
+    auto worker = std::find_if(m_workers.begin(), m_workers.end(),
+        [] (RangeWorker *worker)
+        {
+          return !worker->IsBusy();
+        });
+    if (worker == m_workers.end())
+      break;
+
+    (*worker)->Fetch(m_generation, m_dispatchPos, SEGMENT_SIZE);
+    m_dispatchPos += SEGMENT_SIZE;
+    ++m_inflight;
+  }
+
+  AdaptConnections();
+
+  /* the tail of the recording and everything before m_rangeStart is read
+   * sequentially
+   */
+  if (!m_inflight && m_segments.empty() && m_dispatchPos == m_fillPos)
+  {
+    lock.Unlock();
+    return FillSequential(chunk) || progress;
+  }
+  return progress;
+}
+
+void ReadAheadBuffer::OnSegment(unsigned int generation, uint64_t offset,
+    std::vector<unsigned char> &data, unsigned int requested)
+{
+  m_mutex.Lock();
+  --m_inflight;
+  if (generation == m_generation)
+  {
+    Segment &segment = m_segments[offset];
+    segment.incomplete = (data.size() < requested);
+    segment.data.swap(data);
+  }
+  m_mutex.Unlock();
+  m_spaceEvent.Signal();
+}
+
+void ReadAheadBuffer::AdaptConnections()
+{
+  int64_t now = GetTimeMs();
+  if (now - m_windowStart < ADAPT_INTERVAL)
+    return;
+
+  /* only adjust if the network was the bottleneck */
+  if (!m_windowSaturated && m_windowBytes)
+  {
+    double rate = m_windowBytes * 1000.0 / (now - m_windowStart);
+    /* no significant improvement. try the other direction */
+    if (rate < m_lastRate * 1.1)
+      m_direction = -m_direction;
+
+    unsigned int connections = std::max<int>(1, std::min<int>(
+          m_connections + m_direction, m_workers.size()));
+    if (connections != m_connections)
+    {
+      XBMC->Log(LOG_DEBUG, "ReadAhead: %.0f KiB/s with %u connections. "
+          "Switching to %u", rate / 1024, m_connections, connections);
+      m_connections = connections;
+    }
+    m_lastRate = rate;
+  }
+
+  m_windowStart = now;
+  m_windowBytes = 0;
+  m_windowSaturated = false;
+}
+
+void ReadAheadBuffer::Append(const unsigned char *data, size_t size)
+{
+  size_t tail = (m_head + m_used) % m_ring.size();
+  size_t first = std::min(size, m_ring.size() - tail);
+  memcpy(&m_ring[tail], data, first);
+  memcpy(&m_ring[0], data + first, size - first);
+  m_used    += size;
+  m_fillPos += size;
+  if (m_dispatchPos < m_fillPos)
+    m_dispatchPos = m_fillPos;
+}
+
+ssize_t ReadAheadBuffer::Read(unsigned char *buffer, unsigned int size)
+{
+  bool underrun = false;
+  unsigned int timeWaited = 0;
+
+  m_mutex.Lock();
+  ++m_stats.reads;
+  while (!m_used && !m_eof)
+  {
+    if (!underrun)
+    {
+      ++m_stats.underruns;
+      underrun = true;
+    }
+    if (timeWaited > BUFFER_READ_TIMEOUT)
+    {
+      m_mutex.Unlock();
+      XBMC->Log(LOG_DEBUG, "ReadAhead: Read timed out; waited %u", timeWaited);
+      return -1;
+    }
+    m_mutex.Unlock();
+    m_dataEvent.Wait(BUFFER_READ_WAITTIME);
+    m_mutex.Lock();
+    /* the fill thread is still reading. at the end of an ongoing recording
+     * that read blocks until new data arrives, so don't give up on it
+     */
+    if (!m_filling)
+      timeWaited += BUFFER_READ_WAITTIME;
+  }
+  if (!underrun)
+    ++m_stats.hits;
+
+  size_t len   = std::min<size_t>(size, m_used);
+  size_t first = std::min(len, m_ring.size() - m_head);
+  memcpy(buffer, &m_ring[m_head], first);
+  memcpy(buffer + first, &m_ring[0], len - first);
+  m_head     = (m_head + len) % m_ring.size();
+  m_used    -= len;
+  m_readPos += len;
+  m_stats.bytes += len;
+  m_mutex.Unlock();
+
+  m_spaceEvent.Signal();
+  return len;
+}
+
+int64_t ReadAheadBuffer::Seek(uint64_t position)
+{
+  CLockObject lock(m_mutex);
+  /* forward seek inside the prefetched data. just skip */
+  if (position >= m_readPos && position <= m_readPos + m_used)
+  {
+    size_t skip = position - m_readPos;
+    m_head     = (m_head + skip) % m_ring.size();
+    m_used    -= skip;
+    m_readPos  = position;
+    lock.Unlock();
+    m_spaceEvent.Signal();
+    return position;
+  }
+
+  Reset(position);
+  lock.Unlock();
+  m_spaceEvent.Signal();
+  return position;
+}
+
+void ReadAheadBuffer::Reset(uint64_t position)
+{
+  XBMC->Log(LOG_DEBUG, "ReadAhead: Refilling at %" PRIu64, position);
+  ++m_generation;
+  m_head = m_used = 0;
+  m_readPos = m_fillPos = m_dispatchPos = position;
+  m_sequentialEnd = 0;
+  m_segments.clear();
+  m_eof = false;
+}
+
+int64_t ReadAheadBuffer::Position()
+{
+  CLockObject lock(m_mutex);
+  return m_readPos;
+}
+
+ReadAheadBuffer::Stats ReadAheadBuffer::GetStats()
+{
+  CLockObject lock(m_mutex);
+  m_stats.connections = m_connections;
+  return m_stats;
+}
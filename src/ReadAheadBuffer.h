@@ -0,0 +1,120 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_READAHEADBUFFER_H
+#define PVR_DVBVIEWER_READAHEADBUFFER_H
+
+#include "libXBMC_addon.h"
+#include "p8-platform/threads/threads.h"
+#include <functional>
+#include <vector>
+#include <map>
+
+class ReadAheadBuffer
+  : public P8PLATFORM::CThread
+{
+public:
+  typedef std::function<ssize_t (unsigned char *, unsigned int)> ReadFunc_t;
+  typedef std::function<int64_t (uint64_t)> SeekFunc_t;
+  typedef std::function<int64_t ()> LengthFunc_t;
+
+  struct Stats
+  {
+    unsigned int reads;
+    /*!< @brief reads served without waiting for the network */
+    unsigned int hits;
+    /*!< @brief reads which found the buffer empty */
+    unsigned int underruns;
+    /*!< @brief bytes handed to the reader */
+    uint64_t bytes;
+    /*!< @brief concurrent range requests currently in use */
+    unsigned int connections;
+  };
+
+  ReadAheadBuffer(size_t size, ReadFunc_t readFunc, SeekFunc_t seekFunc);
+  ~ReadAheadBuffer(void);
+  /*!< @brief fetch ahead with up to maxConnections concurrent range requests
+   * instead of reading sequentially through readFunc. Data before rangeStart
+   * (e.g. a local copy) is still read through readFunc. Must be called
+   * before Start()
+   */
+  void EnableRangeRequests(const std::string &url,
+      unsigned int maxConnections, uint64_t rangeStart,
+      LengthFunc_t lengthFunc);
+  bool Start(uint64_t position);
+  ssize_t Read(unsigned char *buffer, unsigned int size);
+  int64_t Seek(uint64_t position);
+  int64_t Position();
+  Stats GetStats();
+
+private:
+  class RangeWorker;
+
+  struct Segment
+  {
+    std::vector<unsigned char> data;
+    /*!< @brief less data than requested was returned */
+    bool incomplete;
+  };
+
+  virtual void *Process(void) override;
+  void Reset(uint64_t position);
+  bool FillSequential(std::vector<unsigned char> &chunk);
+  bool FillParallel(std::vector<unsigned char> &chunk);
+  void OnSegment(unsigned int generation, uint64_t offset,
+      std::vector<unsigned char> &data, unsigned int requested);
+  void AdaptConnections();
+  void Append(const unsigned char *data, size_t size);
+
+  ReadFunc_t m_readFunc;
+  SeekFunc_t m_seekFunc;
+  LengthFunc_t m_lengthFunc;
+
+  std::vector<unsigned char> m_ring;
+  size_t m_head;
+  size_t m_used;
+
+  /*!< @brief position of the first byte inside the ring */
+  uint64_t m_readPos;
+  /*!< @brief position of the next byte to prefetch */
+  uint64_t m_fillPos;
+  /*!< @brief position of the handle behind readFunc */
+  uint64_t m_rawPos;
+  /*!< @brief increases on every seek. prefetches of older generations are
+   * stale and get discarded
+   */
+  unsigned int m_generation;
+  bool m_eof;
+  /*!< @brief time of the next read attempt at the end */
+  int64_t m_eofRetry;
+  /*!< @brief the fill thread is waiting for readFunc */
+  bool m_filling;
+
+  /*!< @brief range request workers and their reorder buffer */
+  std::vector<RangeWorker *> m_workers;
+  /*!< @brief false if disabled or the backend keeps failing them */
+  bool m_rangeRequests;
+  unsigned int m_rangeFailures;
+  uint64_t m_rangeStart;
+  std::map<uint64_t, Segment> m_segments;
+  /*!< @brief position of the next segment to request */
+  uint64_t m_dispatchPos;
+  /*!< @brief a failed range up to here is read sequentially */
+  uint64_t m_sequentialEnd;
+  unsigned int m_inflight;
+  /*!< @brief amount of workers currently in use */
+  unsigned int m_connections;
+
+  /*!< @brief throughput measurement for adjusting m_connections */
+  int64_t m_windowStart;
+  uint64_t m_windowBytes;
+  bool m_windowSaturated;
+  double m_lastRate;
+  int m_direction;
+
+  Stats m_stats;
+  P8PLATFORM::CEvent m_dataEvent;
+  P8PLATFORM::CEvent m_spaceEvent;
+  P8PLATFORM::CMutex m_mutex;
+};
+
+#endif
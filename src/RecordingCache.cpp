@@ -0,0 +1,385 @@
+#include "RecordingCache.h"
+#include "BinaryStream.h"
+#include "DvbData.h"
+#include "client.h"
+#include "p8-platform/util/StringUtils.h"
+#include <inttypes.h>
+#include <set>
+#include <vector>
+
+/* size of a single read from the backend */
+#define DOWNLOAD_CHUNK_SIZE  (256 * 1024)
+/* check the cache size and save the manifest after that many bytes */
+#define EVICT_INTERVAL       (32 * 1024 * 1024)
+#define MANIFEST_FILE        "cache.dat"
+#define MANIFEST_MAGIC       "DVBRCC01"
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+using namespace BinaryStream;
+
+RecordingCache::RecordingCache(const std::string &path, uint64_t maxSize)
+  : m_path(path), m_maxSize(maxSize), m_modified(false), m_paused(false)
+{
+  if (Load())
+    XBMC->Log(LOG_DEBUG, "RecordingCache: Loaded %u entries",
+        m_entries.size());
+  RemoveStrayFiles();
+  CreateThread();
+}
+
+RecordingCache::~RecordingCache(void)
+{
+  StopThread(-1);
+  m_event.Signal();
+  StopThread();
+
+  CLockObject lock(m_mutex);
+  if (m_modified)
+    Save();
+}
+
+void RecordingCache::Add(const std::string &recordingId,
+    const std::string &url)
+{
+  CLockObject lock(m_mutex);
+  auto entry = m_entries.find(recordingId);
+  if ((entry != m_entries.end() && entry->second.complete)
+      || m_rejected.count(recordingId))
+    return;
+  for (auto &item : m_queue)
+  {
+    if (item.first == recordingId)
+      return;
+  }
+
+  XBMC->Log(LOG_DEBUG, "RecordingCache: Queued recording %s",
+      recordingId.c_str());
+  m_queue.push_back(std::make_pair(recordingId, url));
+  m_event.Signal();
+}
+
+bool RecordingCache::Lookup(const std::string &recordingId, std::string &file,
+    uint64_t &length, bool &complete)
+{
+  CLockObject lock(m_mutex);
+  auto entry = m_entries.find(recordingId);
+  if (entry == m_entries.end() || !entry->second.length)
+    return false;
+
+  entry->second.lastUsed = time(NULL);
+  m_pinned = recordingId;
+  m_modified = true;
+
+  file     = FileName(recordingId);
+  length   = entry->second.length;
+  complete = entry->second.complete;
+  return true;
+}
+
+void RecordingCache::Unpin()
+{
+  CLockObject lock(m_mutex);
+  m_pinned.clear();
+}
+
+void RecordingCache::Pause(bool pause)
+{
+  CLockObject lock(m_mutex);
+  if (m_paused == pause)
+    return;
+  XBMC->Log(LOG_DEBUG, "RecordingCache: %s downloads",
+      (pause) ? "Pausing" : "Resuming");
+  m_paused = pause;
+  if (!pause)
+    m_event.Signal();
+}
+
+void *RecordingCache::Process()
+{
+  XBMC->Log(LOG_DEBUG, "RecordingCache: Download thread started");
+  while (!IsStopped())
+  {
+    std::pair<std::string, std::string> item;
+    {
+      CLockObject lock(m_mutex);
+      if (!m_paused && !m_queue.empty())
+      {
+        item = m_queue.front();
+        m_queue.pop_front();
+      }
+    }
+
+    if (item.first.empty())
+    {
+      m_event.Wait();
+      continue;
+    }
+    Download(item.first, item.second);
+  }
+  XBMC->Log(LOG_DEBUG, "RecordingCache: Download thread stopped");
+  return nullptr;
+}
+
+void RecordingCache::Download(const std::string &recordingId,
+    const std::string &url)
+{
+  uint64_t offset;
+  {
+    CLockObject lock(m_mutex);
+    Entry &entry = m_entries.emplace(recordingId,
+        Entry{ 0, false, time(NULL) }).first->second;
+    if (entry.complete)
+      return;
+    offset = entry.length;
+  }
+
+  if (!XBMC->DirectoryExists(m_path.c_str())
+      && !XBMC->CreateDirectory(m_path.c_str()))
+  {
+    XBMC->Log(LOG_ERROR, "RecordingCache: Unable to create %s",
+        m_path.c_str());
+    return;
+  }
+
+  void *srcHandle = XBMC->OpenFile(url.c_str(), READ_NO_CACHE);
+  if (!srcHandle)
+  {
+    XBMC->Log(LOG_ERROR, "RecordingCache: Unable to open %s",
+        Dvb::StripCredentials(url).c_str());
+    return;
+  }
+
+  int64_t totalLen = XBMC->GetFileLength(srcHandle);
+  if (totalLen > 0 && static_cast<uint64_t>(totalLen) > m_maxSize)
+  {
+    XBMC->CloseFile(srcHandle);
+    Reject(recordingId);
+    return;
+  }
+
+  // resume a previous download if possible. otherwise start from scratch
+  if (offset && XBMC->SeekFile(srcHandle, offset, SEEK_SET)
+      != static_cast<int64_t>(offset))
+  {
+    CLockObject lock(m_mutex);
+    m_entries[recordingId].length = offset = 0;
+  }
+
+  std::string file = FileName(recordingId);
+  void *dstHandle = XBMC->OpenFileForWrite(file.c_str(), (offset == 0));
+  if (!dstHandle)
+  {
+    XBMC->Log(LOG_ERROR, "RecordingCache: Unable to write %s", file.c_str());
+    XBMC->CloseFile(srcHandle);
+    return;
+  }
+  if (offset)
+    XBMC->SeekFile(dstHandle, offset, SEEK_SET);
+
+  XBMC->Log(LOG_DEBUG, "RecordingCache: Downloading %s from offset %" PRIu64,
+      recordingId.c_str(), offset);
+  std::vector<unsigned char> buffer(DOWNLOAD_CHUNK_SIZE);
+  uint64_t sinceEvict = 0;
+  bool complete = false, rejected = false;
+  while (!IsStopped())
+  {
+    {
+      CLockObject lock(m_mutex);
+      if (m_paused)
+      {
+        // continue right here as soon as we're resumed
+        m_queue.push_front(std::make_pair(recordingId, url));
+        break;
+      }
+    }
+
+    if (offset >= m_maxSize)
+    {
+      rejected = true;
+      break;
+    }
+
+    ssize_t read = XBMC->ReadFile(srcHandle, buffer.data(), buffer.size());
+    if (read <= 0)
+    {
+      if (read < 0)
+        break;
+      // the recording might have grown since the download started. only a
+      // fresh request tells
+      if (void *probeHandle = XBMC->OpenFile(url.c_str(), READ_NO_CACHE))
+      {
+        totalLen = XBMC->GetFileLength(probeHandle);
+        XBMC->CloseFile(probeHandle);
+      }
+      complete = (totalLen <= 0 || offset >= static_cast<uint64_t>(totalLen));
+      if (!complete)
+        XBMC->Log(LOG_DEBUG, "RecordingCache: Recording %s has grown. "
+            "Resuming later", recordingId.c_str());
+      break;
+    }
+    if (XBMC->WriteFile(dstHandle, buffer.data(), read) != read)
+    {
+      XBMC->Log(LOG_ERROR, "RecordingCache: Unable to write %s",
+          file.c_str());
+      break;
+    }
+    // readers must never see more than what has been written
+    XBMC->FlushFile(dstHandle);
+    offset += read;
+
+    CLockObject lock(m_mutex);
+    m_entries[recordingId].length = offset;
+    m_modified = true;
+    if ((sinceEvict += read) >= EVICT_INTERVAL)
+    {
+      sinceEvict = 0;
+      Evict(recordingId);
+      Save();
+    }
+  }
+  XBMC->CloseFile(dstHandle);
+  XBMC->CloseFile(srcHandle);
+
+  if (rejected)
+  {
+    Reject(recordingId);
+    return;
+  }
+  if (complete)
+    XBMC->Log(LOG_DEBUG, "RecordingCache: Finished download of %s",
+        recordingId.c_str());
+
+  CLockObject lock(m_mutex);
+  m_entries[recordingId].complete = complete;
+  m_modified = true;
+  Evict(recordingId);
+  Save();
+}
+
+void RecordingCache::Reject(const std::string &recordingId)
+{
+  XBMC->Log(LOG_NOTICE, "RecordingCache: Recording %s exceeds the cache size",
+      recordingId.c_str());
+  CLockObject lock(m_mutex);
+  m_rejected.insert(recordingId);
+  if (m_entries.erase(recordingId))
+  {
+    XBMC->DeleteFile(FileName(recordingId).c_str());
+    m_modified = true;
+    Save();
+  }
+}
+
+void RecordingCache::Evict(const std::string &current)
+{
+  uint64_t total = 0;
+  for (auto &entry : m_entries)
+    total += entry.second.length;
+
+  while (total > m_maxSize)
+  {
+    auto victim = m_entries.end();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+      if (it->first == current || it->first == m_pinned)
+        continue;
+      if (victim == m_entries.end()
+          || it->second.lastUsed < victim->second.lastUsed)
+        victim = it;
+    }
+    if (victim == m_entries.end())
+      break;
+
+    XBMC->Log(LOG_DEBUG, "RecordingCache: Evicting recording %s",
+        victim->first.c_str());
+    XBMC->DeleteFile(FileName(victim->first).c_str());
+    total -= victim->second.length;
+    m_entries.erase(victim);
+    m_modified = true;
+  }
+}
+
+std::string RecordingCache::FileName(const std::string &recordingId)
+{
+  return StringUtils::Format("%s/%s.ts", m_path.c_str(), recordingId.c_str());
+}
+
+bool RecordingCache::Load()
+{
+  std::vector<char> content;
+  if (!LoadFile(m_path + "/" MANIFEST_FILE, content))
+    return false;
+
+  Reader reader(content);
+  uint32_t count;
+  if (!reader.ReadMagic(MANIFEST_MAGIC) || !reader.Read(count))
+    return false;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    std::string id;
+    uint64_t length;
+    uint8_t complete;
+    int64_t lastUsed;
+    if (!reader.ReadString(id) || !reader.Read(length)
+        || !reader.Read(complete) || !reader.Read(lastUsed))
+      return false;
+    if (!XBMC->FileExists(FileName(id).c_str(), false))
+      continue;
+    m_entries[id] = Entry{ length, (complete != 0),
+        static_cast<time_t>(lastUsed) };
+  }
+  return true;
+}
+
+void RecordingCache::RemoveStrayFiles()
+{
+  // e.g. downloads of an older manifest format or of a crashed session
+  std::set<std::string> files = { MANIFEST_FILE };
+  for (auto &entry : m_entries)
+    files.insert(entry.first + ".ts");
+
+  VFSDirEntry *items;
+  unsigned int count;
+  if (!XBMC->DirectoryExists(m_path.c_str())
+      || !XBMC->GetDirectory(m_path.c_str(), "", &items, &count))
+    return;
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    if (items[i].folder || files.count(items[i].label))
+      continue;
+    XBMC->Log(LOG_DEBUG, "RecordingCache: Removing %s", items[i].label);
+    XBMC->DeleteFile(items[i].path);
+  }
+  XBMC->FreeDirectory(items, count);
+}
+
+bool RecordingCache::Save()
+{
+  if (!XBMC->DirectoryExists(m_path.c_str()))
+    return false;
+
+  std::string manifest = m_path + "/" MANIFEST_FILE;
+  void *fileHandle = XBMC->OpenFileForWrite(manifest.c_str(), true);
+  if (!fileHandle)
+  {
+    XBMC->Log(LOG_ERROR, "RecordingCache: Unable to write %s",
+        manifest.c_str());
+    return false;
+  }
+
+  std::vector<char> content(MANIFEST_MAGIC,
+      MANIFEST_MAGIC + strlen(MANIFEST_MAGIC));
+  Append<uint32_t>(content, m_entries.size());
+  for (auto &entry : m_entries)
+  {
+    AppendString(content, entry.first);
+    Append<uint64_t>(content, entry.second.length);
+    Append<uint8_t>(content, entry.second.complete);
+    Append<int64_t>(content, entry.second.lastUsed);
+  }
+  XBMC->WriteFile(fileHandle, content.data(), content.size());
+  XBMC->CloseFile(fileHandle);
+  m_modified = false;
+  return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_RECORDINGCACHE_H
+#define PVR_DVBVIEWER_RECORDINGCACHE_H
+
+#include "libXBMC_addon.h"
+#include "p8-platform/threads/threads.h"
+#include <deque>
+#include <map>
+#include <set>
+
+/*!< @brief downloads recordings in the background into a local cache of
+ * bounded size. Least recently used recordings get evicted first
+ */
+class RecordingCache
+  : public P8PLATFORM::CThread
+{
+public:
+  RecordingCache(const std::string &path, uint64_t maxSize);
+  ~RecordingCache(void);
+  /*!< @brief queue a recording for download */
+  void Add(const std::string &recordingId, const std::string &url);
+  /*!< @brief cached part of a recording. also marks it as recently used
+   * @return false if nothing is cached
+   */
+  bool Lookup(const std::string &recordingId, std::string &file,
+      uint64_t &length, bool &complete);
+  /*!< @brief the recording returned by the last Lookup isn't played anymore.
+   * it may be evicted again
+   */
+  void Unpin();
+  /*!< @brief suspend downloads e.g. while watching live tv */
+  void Pause(bool pause);
+
+private:
+  struct Entry
+  {
+    uint64_t length;
+    bool complete;
+    time_t lastUsed;
+  };
+
+  virtual void *Process(void) override;
+  void Download(const std::string &recordingId, const std::string &url);
+  /*!< @brief drop a recording which doesn't fit into the cache */
+  void Reject(const std::string &recordingId);
+  void Evict(const std::string &current);
+  std::string FileName(const std::string &recordingId);
+  bool Load();
+  /*!< @brief delete files no entry refers to */
+  void RemoveStrayFiles();
+  bool Save();
+
+  std::string m_path;
+  uint64_t m_maxSize;
+  /*!< @brief recording id -> cached data */
+  std::map<std::string, Entry> m_entries;
+  bool m_modified;
+  /*!< @brief recordings larger than the cache. they're never queued again */
+  std::set<std::string> m_rejected;
+  /*!< @brief recording id and url of pending downloads */
+  std::deque<std::pair<std::string, std::string>> m_queue;
+  /*!< @brief recording looked up last. it's probably being played */
+  std::string m_pinned;
+  bool m_paused;
+
+  P8PLATFORM::CEvent m_event;
+  P8PLATFORM::CMutex m_mutex;
+};
+
+#endif
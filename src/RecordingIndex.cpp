@@ -0,0 +1,291 @@
+#include "RecordingIndex.h"
+#include "BinaryStream.h"
+#include "client.h"
+#include "p8-platform/util/StringUtils.h"
+#include <algorithm>
+#include <vector>
+
+#define TS_PACKET_SIZE    188
+#define TS_SYNC_BYTE      0x47
+#define PTS_MASK          0x1FFFFFFFFULL
+#define PTS_PER_MS        90
+/* minimum distance between two entries (ms) */
+#define INDEX_INTERVAL    500
+/* lookups further away from the next entry aren't covered (ms) */
+#define INDEX_MAX_GAP     10000
+#define INDEX_MAGIC       "DVBIDX01"
+#define INDEX_PATH        ADDON_DATA_PATH "/index"
+#define INDEX_EXTENSION   ".idx"
+
+using namespace ADDON;
+using namespace BinaryStream;
+
+RecordingIndex::RecordingIndex(const std::string &recordingId)
+  : m_modified(false), m_basePts(0), m_hasBase(false), m_videoPid(-1),
+  m_hasRAI(false), m_carryLen(0), m_nextPos(0), m_chainStart(0)
+{
+  m_path = StringUtils::Format("%s/%s%s", INDEX_PATH, recordingId.c_str(),
+      INDEX_EXTENSION);
+  if (Load())
+    XBMC->Log(LOG_DEBUG, "RecordingIndex: Loaded %u entries for %s",
+        m_entries.size(), recordingId.c_str());
+}
+
+RecordingIndex::~RecordingIndex(void)
+{
+  if (m_modified && m_hasBase)
+    Save();
+}
+
+void RecordingIndex::Parse(uint64_t position, const unsigned char *data,
+    size_t size)
+{
+  /* discontinuity (e.g. seek). resync on the next packet */
+  if (position != m_nextPos)
+  {
+    m_carryLen = 0;
+    m_chainStart = position;
+  }
+  m_nextPos = position + size;
+
+  size_t i = 0;
+  if (m_carryLen)
+  {
+    size_t need = TS_PACKET_SIZE - m_carryLen;
+    if (size < need)
+    {
+      memcpy(m_carry + m_carryLen, data, size);
+      m_carryLen += size;
+      return;
+    }
+    memcpy(m_carry + m_carryLen, data, need);
+    ParsePacket(position - m_carryLen, m_carry);
+    m_carryLen = 0;
+    i = need;
+  }
+
+  while (i + TS_PACKET_SIZE <= size)
+  {
+    if (data[i] != TS_SYNC_BYTE)
+    {
+      ++i;
+      continue;
+    }
+    ParsePacket(position + i, data + i);
+    i += TS_PACKET_SIZE;
+  }
+
+  if (i < size && data[i] == TS_SYNC_BYTE)
+  {
+    m_carryLen = size - i;
+    memcpy(m_carry, data + i, m_carryLen);
+  }
+}
+
+void RecordingIndex::ParsePacket(uint64_t position, const unsigned char *packet)
+{
+  int pid = ((packet[1] & 0x1F) << 8) | packet[2];
+  bool unitStart = (packet[1] & 0x40);
+  if (!unitStart || (m_videoPid >= 0 && pid != m_videoPid))
+    return;
+
+  int adaptationCtrl = (packet[3] >> 4) & 0x03;
+  size_t offset = 4;
+  bool randomAccess = false;
+  if (adaptationCtrl & 0x02)
+  {
+    if (packet[4] > 0)
+      randomAccess = (packet[5] & 0x40);
+    offset = 5 + packet[4];
+  }
+  if (!(adaptationCtrl & 0x01) || offset + 14 > TS_PACKET_SIZE)
+    return;
+
+  /* video PES header with PTS */
+  const unsigned char *pes = packet + offset;
+  if (pes[0] != 0x00 || pes[1] != 0x00 || pes[2] != 0x01
+      || (pes[3] & 0xF0) != 0xE0)
+    return;
+  if (m_videoPid < 0)
+    m_videoPid = pid;
+  if (!(pes[7] & 0x80))
+    return;
+
+  uint64_t pts = (static_cast<uint64_t>(pes[9] & 0x0E) << 29)
+    | (static_cast<uint64_t>(pes[10]) << 22)
+    | (static_cast<uint64_t>(pes[11] & 0xFE) << 14)
+    | (static_cast<uint64_t>(pes[12]) << 7)
+    | (pes[13] >> 1);
+
+  /* the first video frame of the recording defines the time base */
+  if (!m_hasBase)
+  {
+    if (m_chainStart != 0)
+      return;
+    m_basePts = pts;
+    m_hasBase = true;
+    m_modified = true;
+  }
+
+  if (randomAccess)
+    m_hasRAI = true;
+  /* some broadcasters don't set random access indicators at all */
+  if (randomAccess || !m_hasRAI)
+    AddEntry(position, pts);
+}
+
+void RecordingIndex::AddEntry(uint64_t position, uint64_t pts)
+{
+  uint64_t delta = (pts - m_basePts) & PTS_MASK;
+  /* frames before the base frame due to reordering */
+  if (delta > PTS_MASK / 2)
+    return;
+
+  uint32_t time = static_cast<uint32_t>(delta / PTS_PER_MS);
+  auto it = m_entries.lower_bound((time > INDEX_INTERVAL)
+      ? time - INDEX_INTERVAL : 0);
+  if (it != m_entries.end() && it->first < time + INDEX_INTERVAL)
+    return;
+
+  m_entries[time] = position;
+  m_modified = true;
+}
+
+bool RecordingIndex::Lookup(uint32_t time, bool backwards, uint32_t &rapTime,
+    uint64_t &offset)
+{
+  if (m_entries.empty())
+    return false;
+
+  auto it = m_entries.lower_bound(time);
+  if (backwards)
+  {
+    if (it == m_entries.end() || it->first != time)
+    {
+      if (it == m_entries.begin())
+        return false;
+      --it;
+    }
+    if (time - it->first > INDEX_MAX_GAP)
+      return false;
+  }
+  else if (it == m_entries.end() || it->first - time > INDEX_MAX_GAP)
+    return false;
+
+  rapTime = it->first;
+  offset  = it->second;
+  return true;
+}
+
+bool RecordingIndex::Step(uint64_t offset, bool backwards, uint32_t &rapTime,
+    uint64_t &rapOffset)
+{
+  typedef std::pair<const uint32_t, uint64_t> Entry_t;
+  if (backwards)
+  {
+    auto it = std::find_if(m_entries.rbegin(), m_entries.rend(),
+        [offset] (const Entry_t &entry)
+        {
+          return (entry.second < offset);
+        });
+    if (it == m_entries.rend())
+      return false;
+    rapTime   = it->first;
+    rapOffset = it->second;
+    return true;
+  }
+
+  auto it = std::find_if(m_entries.begin(), m_entries.end(),
+      [offset] (const Entry_t &entry)
+      {
+        return (entry.second > offset);
+      });
+  if (it == m_entries.end())
+    return false;
+  rapTime   = it->first;
+  rapOffset = it->second;
+  return true;
+}
+
+uint32_t RecordingIndex::Duration()
+{
+  return (m_entries.empty()) ? 0 : m_entries.rbegin()->first;
+}
+
+void RecordingIndex::Prune(const std::set<std::string> &recordingIds)
+{
+  VFSDirEntry *items;
+  unsigned int count;
+  if (!XBMC->DirectoryExists(INDEX_PATH)
+      || !XBMC->GetDirectory(INDEX_PATH, INDEX_EXTENSION, &items, &count))
+    return;
+
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    std::string name = items[i].label;
+    if (items[i].folder || !StringUtils::EndsWith(name, INDEX_EXTENSION))
+      continue;
+    name.erase(name.size() - strlen(INDEX_EXTENSION));
+    if (recordingIds.find(name) != recordingIds.end())
+      continue;
+    XBMC->Log(LOG_DEBUG, "RecordingIndex: Removing index of deleted "
+        "recording %s", name.c_str());
+    XBMC->DeleteFile(items[i].path);
+  }
+  XBMC->FreeDirectory(items, count);
+}
+
+bool RecordingIndex::Load()
+{
+  std::vector<char> content;
+  if (!LoadFile(m_path, content))
+    return false;
+
+  Reader reader(content);
+  uint64_t basePts;
+  uint32_t count;
+  if (!reader.ReadMagic(INDEX_MAGIC) || !reader.Read(basePts)
+      || !reader.Read(count))
+    return false;
+
+  std::map<uint32_t, uint64_t> entries;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    uint32_t time;
+    uint64_t offset;
+    if (!reader.Read(time) || !reader.Read(offset))
+      return false;
+    entries[time] = offset;
+  }
+  m_entries.swap(entries);
+  m_basePts = basePts;
+  m_hasBase = true;
+  return true;
+}
+
+bool RecordingIndex::Save()
+{
+  std::string dir = m_path.substr(0, m_path.rfind('/'));
+  if (!XBMC->DirectoryExists(dir.c_str()) && !XBMC->CreateDirectory(dir.c_str()))
+    return false;
+
+  void *fileHandle = XBMC->OpenFileForWrite(m_path.c_str(), true);
+  if (!fileHandle)
+  {
+    XBMC->Log(LOG_ERROR, "RecordingIndex: Unable to write %s", m_path.c_str());
+    return false;
+  }
+
+  std::vector<char> content(INDEX_MAGIC, INDEX_MAGIC + strlen(INDEX_MAGIC));
+  Append<uint64_t>(content, m_basePts);
+  Append<uint32_t>(content, m_entries.size());
+  for (auto &entry : m_entries)
+  {
+    Append<uint32_t>(content, entry.first);
+    Append<uint64_t>(content, entry.second);
+  }
+  XBMC->WriteFile(fileHandle, content.data(), content.size());
+  XBMC->CloseFile(fileHandle);
+  m_modified = false;
+  return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_RECORDINGINDEX_H
+#define PVR_DVBVIEWER_RECORDINGINDEX_H
+
+#include "libXBMC_addon.h"
+#include <map>
+#include <set>
+
+/*!< @brief sparse index of a transport stream recording mapping playback
+ * time to the byte offset of random access points (e.g. I-frames).
+ * It's built while the recording is being read and cached on disk
+ */
+class RecordingIndex
+{
+public:
+  RecordingIndex(const std::string &recordingId);
+  ~RecordingIndex(void);
+
+  /*!< @brief feed data read at position into the index */
+  void Parse(uint64_t position, const unsigned char *data, size_t size);
+  /*!< @brief look up the random access point at or before (backwards) or
+   * after time. time is in milliseconds from the start of the recording
+   * @return false if time isn't covered by the index
+   */
+  bool Lookup(uint32_t time, bool backwards, uint32_t &rapTime,
+      uint64_t &offset);
+  /*!< @brief random access point following/preceding the one at offset */
+  bool Step(uint64_t offset, bool backwards, uint32_t &rapTime,
+      uint64_t &rapOffset);
+  uint32_t Duration();
+  /*!< @brief the time base is known. Without it nothing gets indexed */
+  bool HasBase() const { return m_hasBase; }
+
+  /*!< @brief delete the index files of recordings not in recordingIds */
+  static void Prune(const std::set<std::string> &recordingIds);
+
+private:
+  bool Load();
+  bool Save();
+  void ParsePacket(uint64_t position, const unsigned char *packet);
+  void AddEntry(uint64_t position, uint64_t pts);
+
+  std::string m_path;
+  /*!< @brief time (ms) -> offset */
+  std::map<uint32_t, uint64_t> m_entries;
+  bool m_modified;
+
+  /*!< @brief PTS at the start of the recording */
+  uint64_t m_basePts;
+  bool m_hasBase;
+  int m_videoPid;
+  /*!< @brief stream has random access indicators. otherwise every PES
+   * start is indexed
+   */
+  bool m_hasRAI;
+
+  /*!< @brief partial packet carried over to the next call */
+  unsigned char m_carry[188];
+  size_t m_carryLen;
+  /*!< @brief position the next call is expected at */
+  uint64_t m_nextPos;
+  /*!< @brief position where continuous parsing started */
+  uint64_t m_chainStart;
+};
+
+#endif
@@ -2,95 +2,467 @@
 #include "client.h"
 #include "p8-platform/util/util.h"
 #include "p8-platform/threads/mutex.h"
+#include "p8-platform/util/StringUtils.h"
+#include "p8-platform/util/timeutils.h"
 #include <algorithm>
+#include <inttypes.h>
+#ifdef TARGET_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 
-#define REOPEN_INTERVAL      30
-#define REOPEN_INTERVAL_FAST 10
+#define PROBE_INTERVAL_MIN   1
+#define PROBE_INTERVAL_MAX   30
+#define END_WAIT_STEP        250
+#define END_WAIT_TIMEOUT     15000
+/* the first video frame is expected within this amount of bytes */
+#define INDEX_PROBE_SIZE     (1024 * 1024)
+
+#ifndef SEEK_POSSIBLE
+#define SEEK_POSSIBLE 0x10000
+#endif
 
 using namespace ADDON;
+using namespace P8PLATFORM;
 
-RecordingReader::RecordingReader(const std::string &streamURL, time_t end)
-  : m_streamURL(streamURL), m_end(end), m_fastReopen(false), m_playback(false)
+RecordingReader::RecordingReader(const std::string &streamURL, time_t end,
+    const std::string &recordingId)
+  : m_streamURL(streamURL), m_index(recordingId), m_indexProbed(false),
+  m_end(end), m_probeInterval(PROBE_INTERVAL_MIN)
 {
-  m_readHandle = XBMC->OpenFile(m_streamURL.c_str(), 0);
-  m_len = XBMC->GetFileLength(m_readHandle);
+  m_readHandle = m_cacheHandle = nullptr;
+  m_cacheLen = 0;
+  m_inCache = false;
+#ifdef TARGET_POSIX
+  m_fd = -1;
+#endif
+  FileOpen();
+  m_len = FileLength();
   m_pos = 0;
-  m_nextReopen = time(NULL) + REOPEN_INTERVAL;
+  m_probedLen = m_len;
+
+  m_readAhead = nullptr;
+  m_reported = { 0, 0, 0, 0, 0 };
+  m_reportTime = GetTimeMs();
+  if (g_readAheadSize > 0)
+    m_readAhead = new ReadAheadBuffer(g_readAheadSize * 1024 * 1024,
+        [this] (unsigned char *buffer, unsigned int size)
+        {
+          return ReadRaw(buffer, size);
+        },
+        [this] (uint64_t position)
+        {
+          return SeekRaw(position, SEEK_SET);
+        });
   XBMC->Log(LOG_DEBUG, "RecordingReader: Started; url=%s, end=%u",
       m_streamURL.c_str(), m_end);
 }
 
 RecordingReader::~RecordingReader(void)
 {
-  if (m_readHandle)
-    XBMC->CloseFile(m_readHandle);
+  ReportStats("close");
+  SAFE_DELETE(m_readAhead);
+  StopThread(-1);
+  m_probeEvent.Signal();
+  StopThread();
+
+  FileClose();
+  if (m_cacheHandle)
+    XBMC->CloseFile(m_cacheHandle);
   XBMC->Log(LOG_DEBUG, "RecordingReader: Stopped");
 }
 
+bool RecordingReader::UseCache(const std::string &file, uint64_t length)
+{
+  m_cacheHandle = XBMC->OpenFile(file.c_str(), 0);
+  if (!m_cacheHandle)
+    return false;
+  m_cacheLen = length;
+  m_inCache = (m_pos < m_cacheLen);
+  if (m_inCache)
+    XBMC->SeekFile(m_cacheHandle, m_pos, SEEK_SET);
+  XBMC->Log(LOG_DEBUG, "RecordingReader: Serving %" PRIu64 " bytes from %s",
+      m_cacheLen, file.c_str());
+  return true;
+}
+
 bool RecordingReader::Start()
 {
-  return (m_readHandle != nullptr);
+  if (!IsOpen())
+    return false;
+  /* ongoing recording: watch its growth in the background */
+  if (m_end && !IsRunning())
+    CreateThread();
+  /* the locally cached beginning is read through ReadRaw */
+  if (m_readAhead && g_readAheadConnections > 1
+      && StringUtils::StartsWith(m_streamURL, "http"))
+    m_readAhead->EnableRangeRequests(m_streamURL, g_readAheadConnections,
+        m_cacheLen,
+        [this] ()
+        {
+          return Length();
+        });
+  if (m_readAhead && !m_readAhead->Start(m_pos))
+    SAFE_DELETE(m_readAhead);
+  return true;
 }
 
-ssize_t RecordingReader::ReadData(unsigned char *buffer, unsigned int size)
+void *RecordingReader::Process()
 {
-  /* check for playback of ongoing recording */
-  if (m_playback && m_end)
+  XBMC->Log(LOG_DEBUG, "RecordingReader: Prober started");
+  while (!IsStopped())
   {
-    time_t now = time(NULL);
-    if (now > m_nextReopen)
+    m_probeEvent.Wait(m_probeInterval * 1000);
+    if (IsStopped())
+      break;
+
+    uint64_t len = 0;
+#ifdef TARGET_POSIX
+    struct stat st;
+    if (m_fd >= 0 && stat(m_streamURL.c_str(), &st) == 0)
+      len = st.st_size;
+    else
+#endif
+    /* a fresh request gives us the current length of the file */
+    if (void *probeHandle = XBMC->OpenFile(m_streamURL.c_str(), READ_NO_CACHE))
     {
-FORCE_REOPEN:
-      /* reopen stream */
-      XBMC->Log(LOG_DEBUG, "RecordingReader: Reopening stream...");
-      XBMC->CloseFile(m_readHandle);
-      m_readHandle = XBMC->OpenFile(m_streamURL.c_str(), 0);
-      m_len = XBMC->GetFileLength(m_readHandle);
-      XBMC->SeekFile(m_readHandle, m_pos, SEEK_SET);
+      len = XBMC->GetFileLength(probeHandle);
+      XBMC->CloseFile(probeHandle);
+    }
 
-      m_nextReopen = now + ((m_fastReopen) ? REOPEN_INTERVAL_FAST : REOPEN_INTERVAL);
+    CLockObject lock(m_mutex);
+    if (len > m_probedLen)
+    {
+      m_probedLen = len;
+      m_probeInterval = PROBE_INTERVAL_MIN;
+      m_growthEvent.Signal();
+      continue;
+    }
 
+    m_probeInterval = std::min<unsigned int>(m_probeInterval * 2, PROBE_INTERVAL_MAX);
+    if (time(NULL) > m_end)
+    {
       /* recording has finished */
-      if (now > m_end)
-        m_end = 0;
+      XBMC->Log(LOG_DEBUG, "RecordingReader: Recording has finished");
+      m_end = 0;
+      m_growthEvent.Signal();
+      break;
     }
-    else if (m_pos == m_len)
+  }
+  XBMC->Log(LOG_DEBUG, "RecordingReader: Prober stopped");
+  return nullptr;
+}
+
+bool RecordingReader::Reopen(uint64_t position)
+{
+  XBMC->Log(LOG_DEBUG, "RecordingReader: Reopening stream at %" PRIu64,
+      position);
+  FileClose();
+  if (!FileOpen())
+    return false;
+  FileSeek(position, SEEK_SET);
+  m_pos = FilePosition();
+
+  CLockObject lock(m_mutex);
+  m_len = FileLength();
+  m_probedLen = std::max(m_probedLen, m_len);
+  return true;
+}
+
+void RecordingReader::ProbeIndexBase()
+{
+  m_indexProbed = true;
+  /* the read handle might be owned by the read-ahead thread */
+  void *probeHandle = XBMC->OpenFile(m_streamURL.c_str(), READ_NO_CACHE);
+  if (!probeHandle)
+    return;
+
+  std::vector<unsigned char> buffer(64 * 1024);
+  uint64_t position = 0;
+  while (!m_index.HasBase() && position < INDEX_PROBE_SIZE)
+  {
+    ssize_t read = XBMC->ReadFile(probeHandle, buffer.data(), buffer.size());
+    if (read <= 0)
+      break;
+    m_index.Parse(position, buffer.data(), read);
+    position += read;
+  }
+  XBMC->CloseFile(probeHandle);
+  XBMC->Log(LOG_DEBUG, "RecordingReader: Index time base %s",
+      (m_index.HasBase()) ? "found" : "not found");
+}
+
+bool RecordingReader::FileOpen()
+{
+#ifdef TARGET_POSIX
+  /* plain local file. bypass the VFS and tell the kernel how we read */
+  if (m_streamURL.find("://") == std::string::npos)
+  {
+    m_fd = open(m_streamURL.c_str(), O_RDONLY);
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (m_fd >= 0)
+      posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return (m_fd >= 0);
+  }
+#endif
+  m_readHandle = XBMC->OpenFile(m_streamURL.c_str(), 0);
+  return (m_readHandle != nullptr);
+}
+
+void RecordingReader::FileClose()
+{
+#ifdef TARGET_POSIX
+  if (m_fd >= 0)
+    close(m_fd);
+  m_fd = -1;
+#endif
+  if (m_readHandle)
+    XBMC->CloseFile(m_readHandle);
+  m_readHandle = nullptr;
+}
+
+bool RecordingReader::IsOpen()
+{
+#ifdef TARGET_POSIX
+  if (m_fd >= 0)
+    return true;
+#endif
+  return (m_readHandle != nullptr);
+}
+
+ssize_t RecordingReader::FileRead(unsigned char *buffer, unsigned int size)
+{
+  /* locally cached beginning of the recording */
+  if (m_inCache)
+  {
+    if (m_pos < m_cacheLen)
+      return XBMC->ReadFile(m_cacheHandle, buffer,
+          std::min<uint64_t>(size, m_cacheLen - m_pos));
+    /* continue from the network. retry on the next read if that fails */
+    if (FileSeek(m_pos, SEEK_SET) < 0)
+    {
+      m_inCache = true;
+      return -1;
+    }
+  }
+
+#ifdef TARGET_POSIX
+  if (m_fd >= 0)
+    return read(m_fd, buffer, size);
+#endif
+  return XBMC->ReadFile(m_readHandle, buffer, size);
+}
+
+int64_t RecordingReader::FileSeek(long long position, int whence)
+{
+  if (m_cacheHandle && whence != SEEK_POSSIBLE)
+  {
+    if (whence == SEEK_CUR)
+      position += m_pos;
+    else if (whence == SEEK_END)
+      position += FileLength();
+    whence = SEEK_SET;
+
+    m_inCache = (position >= 0 && static_cast<uint64_t>(position) < m_cacheLen);
+    if (m_inCache)
+      return XBMC->SeekFile(m_cacheHandle, position, SEEK_SET);
+  }
+
+#ifdef TARGET_POSIX
+  if (m_fd >= 0)
+    return (whence == SEEK_POSSIBLE) ? 1 : lseek(m_fd, position, whence);
+#endif
+  return XBMC->SeekFile(m_readHandle, position, whence);
+}
+
+int64_t RecordingReader::FilePosition()
+{
+  if (m_inCache)
+    return XBMC->GetFilePosition(m_cacheHandle);
+#ifdef TARGET_POSIX
+  if (m_fd >= 0)
+    return lseek(m_fd, 0, SEEK_CUR);
+#endif
+  return XBMC->GetFilePosition(m_readHandle);
+}
+
+int64_t RecordingReader::FileLength()
+{
+  int64_t len;
+#ifdef TARGET_POSIX
+  struct stat st;
+  if (m_fd >= 0)
+    len = (fstat(m_fd, &st) == 0) ? st.st_size : 0;
+  else
+#endif
+  len = XBMC->GetFileLength(m_readHandle);
+  return std::max<int64_t>(len, m_cacheLen);
+}
+
+bool RecordingReader::IsOngoing()
+{
+  CLockObject lock(m_mutex);
+  return (m_end != 0);
+}
+
+ssize_t RecordingReader::ReadData(unsigned char *buffer, unsigned int size)
+{
+  int64_t position = Position();
+  if (position != 0 && !m_index.HasBase() && !m_indexProbed)
+    ProbeIndexBase();
+  ssize_t read = (m_readAhead) ? m_readAhead->Read(buffer, size)
+    : ReadRaw(buffer, size);
+  if (read > 0)
+    m_index.Parse(position, buffer, read);
+  return read;
+}
+
+ssize_t RecordingReader::ReadRaw(unsigned char *buffer, unsigned int size)
+{
+  /* the current handle is exhausted. check if the recording has grown */
+  if (IsOpen() && m_pos >= m_len)
+  {
+    bool requested = false;
+    unsigned int waited = 0;
+    for (;;)
     {
-      /* in case we reached the end we need to wait a little */
-      int sleep = REOPEN_INTERVAL_FAST + 5;
-      if (!m_fastReopen)
-        sleep = std::min(sleep, static_cast<int>(m_nextReopen - now + 1));
-      XBMC->Log(LOG_DEBUG, "RecordingReader: End reached. Sleeping %d secs",
-          sleep);
-      P8PLATFORM::CEvent::Sleep(sleep * 1000);
-      now += sleep;
-      m_fastReopen = true;
-      goto FORCE_REOPEN;
+      m_mutex.Lock();
+      uint64_t probedLen = m_probedLen;
+      m_mutex.Unlock();
+
+      if (probedLen > m_len)
+      {
+        Reopen(m_pos);
+        break;
+      }
+
+      /* ffmpeg also reads till the end while probing. an ongoing
+       * recording grows steadily, so the prober ends that wait quickly */
+      if (!IsOngoing() || waited >= END_WAIT_TIMEOUT)
+        break;
+
+      if (!requested)
+      {
+        XBMC->Log(LOG_DEBUG, "RecordingReader: End reached. Waiting for data");
+        m_probeEvent.Signal();
+        requested = true;
+      }
+      m_growthEvent.Wait(END_WAIT_STEP);
+      waited += END_WAIT_STEP;
     }
   }
 
-  ssize_t read = XBMC->ReadFile(m_readHandle, buffer, size);
-  m_pos += read;
+  if (!IsOpen())
+    return -1;
+
+  ssize_t read = FileRead(buffer, size);
+  if (read > 0)
+    m_pos += read;
   return read;
 }
 
 int64_t RecordingReader::Seek(long long position, int whence)
 {
-  int64_t ret = XBMC->SeekFile(m_readHandle, position, whence);
+  if (m_readAhead)
+  {
+    if (whence != SEEK_POSSIBLE)
+      ReportStats("seek");
+    /* the read handle is owned by the read-ahead thread */
+    switch (whence)
+    {
+      case SEEK_SET:
+        return m_readAhead->Seek(position);
+      case SEEK_CUR:
+        return m_readAhead->Seek(m_readAhead->Position() + position);
+      case SEEK_END:
+        return m_readAhead->Seek(Length() + position);
+      case SEEK_POSSIBLE:
+        return 1;
+    }
+    return -1;
+  }
+  return SeekRaw(position, whence);
+}
+
+void RecordingReader::ReportStats(const char *event)
+{
+  if (!m_readAhead)
+    return;
+
+  ReadAheadBuffer::Stats stats = m_readAhead->GetStats();
+  unsigned int reads = stats.reads - m_reported.reads;
+  if (!reads)
+    return;
+  unsigned int hits = stats.hits - m_reported.hits;
+  int64_t now = GetTimeMs();
+  double rate = (now > m_reportTime)
+    ? (stats.bytes - m_reported.bytes) * 1000.0 / (now - m_reportTime) / 1024
+    : 0.0;
+
+  XBMC->Log(LOG_DEBUG, "RecordingReader: Read-ahead until %s; reads=%u, "
+      "hits=%u (%.1f%%), underruns=%u, throughput=%.0f KiB/s, connections=%u",
+      event, reads, hits, hits * 100.0 / reads,
+      stats.underruns - m_reported.underruns, rate, stats.connections);
+  m_reported   = stats;
+  m_reportTime = now;
+}
+
+int64_t RecordingReader::SeekRaw(long long position, int whence)
+{
+  /* target is beyond the current handle but has been probed already */
+  if (whence == SEEK_SET || whence == SEEK_CUR)
+  {
+    uint64_t target = (whence == SEEK_SET) ? position : m_pos + position;
+    m_mutex.Lock();
+    uint64_t probedLen = m_probedLen;
+    m_mutex.Unlock();
+    if (target > m_len && target <= probedLen && Reopen(target))
+      return m_pos;
+  }
+
+  int64_t ret = FileSeek(position, whence);
   // for unknown reason seek sometimes doesn't return the correct position
   // so let's sync with the underlaying implementation
-  m_pos = XBMC->GetFilePosition(m_readHandle);
-  m_len = XBMC->GetFileLength(m_readHandle);
+  m_pos = FilePosition();
+  CLockObject lock(m_mutex);
+  m_len = FileLength();
   return ret;
 }
 
+bool RecordingReader::SeekTime(double time, bool backwards, double *startpts)
+{
+  uint32_t rapTime;
+  uint64_t offset;
+  if (!m_index.Lookup(static_cast<uint32_t>(time), backwards, rapTime, offset))
+    return false;
+
+  /* we're already there (e.g. skipping). jump to the next random access point */
+  int64_t position = Position();
+  if (offset == static_cast<uint64_t>(position)
+      && !m_index.Step(offset, backwards, rapTime, offset))
+    return false;
+
+  if (Seek(offset, SEEK_SET) < 0)
+    return false;
+
+  XBMC->Log(LOG_DEBUG, "RecordingReader: Seek to %.0fms -> %ums at %" PRIu64,
+      time, rapTime, offset);
+  if (startpts)
+    *startpts = rapTime * (DVD_TIME_BASE / 1000.0);
+  return true;
+}
+
 int64_t RecordingReader::Position()
 {
+  if (m_readAhead)
+    return m_readAhead->Position();
   return m_pos;
 }
 
 int64_t RecordingReader::Length()
 {
-  return m_len;
+  CLockObject lock(m_mutex);
+  return std::max(m_len, m_probedLen);
 }
-
@@ -3,36 +3,90 @@
 #ifndef PVR_DVBVIEWER_RECORDINGREADER_H
 #define PVR_DVBVIEWER_RECORDINGREADER_H
 
+#include "ReadAheadBuffer.h"
+#include "RecordingIndex.h"
 #include "libXBMC_addon.h"
+#include "p8-platform/threads/threads.h"
 
 class RecordingReader
+  : public P8PLATFORM::CThread
 {
 public:
-  RecordingReader(const std::string &streamURL, time_t end);
+  RecordingReader(const std::string &streamURL, time_t end,
+      const std::string &recordingId);
   ~RecordingReader(void);
+  /*!< @brief serve the first length bytes from a local copy. Must be called
+   * before Start()
+   */
+  bool UseCache(const std::string &file, uint64_t length);
   bool Start();
   ssize_t ReadData(unsigned char *buffer, unsigned int size);
   int64_t Seek(long long position, int whence);
   int64_t Position();
   int64_t Length();
-  void OnPlay() { m_playback = true; }
+  /*!< @brief seek to the random access point nearest to time (ms) */
+  bool SeekTime(double time, bool backwards, double *startpts);
 
 private:
+  virtual void *Process(void) override;
+  bool Reopen(uint64_t position);
+  /*!< @brief feed the start of the recording into the index. Resumed
+   * playback never reads it, but the index needs its time base
+   */
+  void ProbeIndexBase();
+  bool IsOngoing();
+  ssize_t ReadRaw(unsigned char *buffer, unsigned int size);
+  int64_t SeekRaw(long long position, int whence);
+  /*!< @brief log the read-ahead statistics since the last report */
+  void ReportStats(const char *event);
+
+  /* access to the underlying file. either through Kodi's VFS or directly */
+  bool FileOpen();
+  void FileClose();
+  bool IsOpen();
+  ssize_t FileRead(unsigned char *buffer, unsigned int size);
+  int64_t FileSeek(long long position, int whence);
+  int64_t FilePosition();
+  int64_t FileLength();
+
+  /*!< @brief url of the recording or path of the file on a local mount */
   std::string m_streamURL;
   void *m_readHandle;
+#ifdef TARGET_POSIX
+  /*!< @brief file descriptor in case of a plain local file */
+  int m_fd;
+#endif
+  /*!< @brief locally cached beginning of the recording */
+  void *m_cacheHandle;
+  uint64_t m_cacheLen;
+  /*!< @brief the cache handle is the active one */
+  bool m_inCache;
+  /*!< @brief optional prefetching of data ahead of the read position */
+  ReadAheadBuffer *m_readAhead;
+  /*!< @brief read-ahead statistics and time (ms) of the last report */
+  ReadAheadBuffer::Stats m_reported;
+  int64_t m_reportTime;
+  RecordingIndex m_index;
+  /*!< @brief ProbeIndexBase has been tried already */
+  bool m_indexProbed;
 
   /*!< @brief end time of the recording in case this an ongoing recording */
   time_t m_end;
-  time_t m_nextReopen;
-  bool m_fastReopen;
 
-  /*!< @brief indicates if ffmpeg playback has started
-   * In case we reach the end we need to sleep until the next reopen. However
-   * during start/seek/jump/resume ffmpeg seeks and reads till the end.
-   */
-  bool m_playback;
+  /*!< @brief position of the read handle */
   uint64_t m_pos;
+  /*!< @brief length known to the current read handle */
   uint64_t m_len;
+
+  /*!< @brief length reported by the last probe of an ongoing recording */
+  uint64_t m_probedLen;
+  /*!< @brief seconds until next probe. doubles if the recording didn't grow */
+  unsigned int m_probeInterval;
+  /*!< @brief signaled by the reader to request an immediate probe */
+  P8PLATFORM::CEvent m_probeEvent;
+  /*!< @brief signaled by the prober as soon as new data is available */
+  P8PLATFORM::CEvent m_growthEvent;
+  P8PLATFORM::CMutex m_mutex;
 };
 
 #endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_SMALLVECTOR_H
+#define PVR_DVBVIEWER_SMALLVECTOR_H
+
+#include <cstring>
+#include <stdint.h>
+
+/*!< @brief vector for plain values which keeps up to N of them inline. It
+ * only allocates if there are more. T has to be trivially copyable
+ */
+template<typename T, size_t N>
+class SmallVector
+{
+public:
+  SmallVector()
+    : m_data(m_inline), m_size(0), m_capacity(N)
+  {}
+  SmallVector(const SmallVector &other)
+    : SmallVector()
+  {
+    *this = other;
+  }
+  ~SmallVector()
+  {
+    if (m_data != m_inline)
+      delete[] m_data;
+  }
+
+  SmallVector &operator=(const SmallVector &other)
+  {
+    if (this == &other)
+      return *this;
+    m_size = 0;
+    reserve(other.m_size);
+    memcpy(m_data, other.m_data, other.m_size * sizeof(T));
+    m_size = other.m_size;
+    return *this;
+  }
+
+  void reserve(size_t capacity)
+  {
+    if (capacity <= m_capacity)
+      return;
+    T *data = new T[capacity];
+    memcpy(data, m_data, m_size * sizeof(T));
+    if (m_data != m_inline)
+      delete[] m_data;
+    m_data = data;
+    m_capacity = capacity;
+  }
+
+  void push_back(const T &value)
+  {
+    if (m_size == m_capacity)
+      reserve(m_capacity * 2);
+    m_data[m_size++] = value;
+  }
+
+  void clear() { m_size = 0; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  const T *begin() const { return m_data; }
+  const T *end() const { return m_data + m_size; }
+  const T &front() const { return m_data[0]; }
+  const T &operator[](size_t pos) const { return m_data[pos]; }
+
+  bool operator==(const SmallVector &other) const
+  {
+    return (m_size == other.m_size
+        && memcmp(m_data, other.m_data, m_size * sizeof(T)) == 0);
+  }
+  bool operator!=(const SmallVector &other) const
+  {
+    return !(*this == other);
+  }
+
+private:
+  T m_inline[N];
+  T *m_data;
+  uint32_t m_size, m_capacity;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "Snapshot.h"
+#include "BinaryStream.h"
+#include "DvbData.h"
+#include "client.h"
+
+#define SNAPSHOT_MAGIC    "DVBSNP01"
+
+using namespace ADDON;
+using namespace BinaryStream;
+
+Snapshot::Snapshot(const std::string &path)
+  : m_path(path)
+{
+}
+
+bool Snapshot::Load(std::vector<DvbChannel> &channels,
+    std::vector<DvbGroup> &groups, std::vector<DvbTimer> &timers)
+{
+  std::vector<char> content;
+  if (!LoadFile(m_path + "/snapshot.dat", content))
+    return false;
+
+  Reader reader(content);
+  uint32_t count;
+  if (!reader.ReadMagic(SNAPSHOT_MAGIC) || !reader.Read(count))
+    return false;
+  std::vector<DvbChannel> newChannels(count);
+  for (auto &channel : newChannels)
+  {
+    uint32_t backendIds;
+    uint8_t radio, hidden, encrypted;
+    if (!reader.Read(channel.id) || !reader.Read(channel.frontendNr)
+        || !reader.Read(backendIds) || !backendIds)
+      return false;
+    for (uint32_t i = 0; i < backendIds; ++i)
+    {
+      uint64_t backendId;
+      if (!reader.Read(backendId))
+        return false;
+      channel.backendIds.push_back(backendId);
+    }
+    if (!reader.Read(channel.epgId) || !reader.ReadString(channel.name)
+        || !reader.ReadString(channel.backendName)
+        || !reader.ReadString(channel.logo) || !reader.Read(radio)
+        || !reader.Read(hidden) || !reader.Read(encrypted))
+      return false;
+    channel.radio     = radio;
+    channel.hidden    = hidden;
+    channel.encrypted = encrypted;
+  }
+
+  if (!reader.Read(count))
+    return false;
+  std::vector<DvbGroup> newGroups(count);
+  for (auto &group : newGroups)
+  {
+    uint32_t members;
+    uint8_t radio, hidden;
+    if (!reader.ReadString(group.name) || !reader.ReadString(group.backendName)
+        || !reader.Read(members))
+      return false;
+    for (uint32_t i = 0; i < members; ++i)
+    {
+      uint32_t index;
+      if (!reader.Read(index) || index >= newChannels.size())
+        return false;
+      group.channels.push_back(index);
+    }
+    if (!reader.Read(radio) || !reader.Read(hidden))
+      return false;
+    group.radio  = radio;
+    group.hidden = hidden;
+  }
+
+  if (!reader.Read(count))
+    return false;
+  std::vector<DvbTimer> newTimers(count);
+  for (auto &timer : newTimers)
+  {
+    int64_t start, end;
+    int32_t state;
+    if (!reader.Read(timer.id) || !reader.ReadString(timer.guid)
+        || !reader.Read(timer.backendId) || !reader.Read(timer.channelId)
+        || !reader.ReadString(timer.title) || !reader.Read(start)
+        || !reader.Read(end) || !reader.Read(timer.priority)
+        || !reader.Read(timer.weekdays) || !reader.Read(state))
+      return false;
+    timer.channel     = nullptr;
+    timer.start       = static_cast<time_t>(start);
+    timer.end         = static_cast<time_t>(end);
+    timer.state       = static_cast<PVR_TIMER_STATE>(state);
+    timer.updateState = DvbTimer::State::FOUND;
+  }
+
+  channels.swap(newChannels);
+  groups.swap(newGroups);
+  timers.swap(newTimers);
+  return true;
+}
+
+bool Snapshot::Save(const std::vector<DvbChannel> &channels,
+    const std::vector<DvbGroup> &groups, const std::vector<DvbTimer> &timers)
+{
+  std::vector<char> content(SNAPSHOT_MAGIC,
+      SNAPSHOT_MAGIC + strlen(SNAPSHOT_MAGIC));
+  Append<uint32_t>(content, channels.size());
+  for (auto &channel : channels)
+  {
+    Append<uint32_t>(content, channel.id);
+    Append<uint32_t>(content, channel.frontendNr);
+    Append<uint32_t>(content, channel.backendIds.size());
+    for (uint64_t backendId : channel.backendIds)
+      Append<uint64_t>(content, backendId);
+    Append<uint64_t>(content, channel.epgId);
+    AppendString(content, channel.name);
+    AppendString(content, channel.backendName);
+    AppendString(content, channel.logo);
+    Append<uint8_t>(content, channel.radio);
+    Append<uint8_t>(content, channel.hidden);
+    Append<uint8_t>(content, channel.encrypted);
+  }
+
+  Append<uint32_t>(content, groups.size());
+  for (auto &group : groups)
+  {
+    AppendString(content, group.name);
+    AppendString(content, group.backendName);
+    Append<uint32_t>(content, group.channels.size());
+    for (unsigned int index : group.channels)
+      Append<uint32_t>(content, index);
+    Append<uint8_t>(content, group.radio);
+    Append<uint8_t>(content, group.hidden);
+  }
+
+  Append<uint32_t>(content, timers.size());
+  for (auto &timer : timers)
+  {
+    Append<uint32_t>(content, timer.id);
+    AppendString(content, timer.guid);
+    Append<uint32_t>(content, timer.backendId);
+    Append<uint64_t>(content, timer.channelId);
+    AppendString(content, timer.title);
+    Append<int64_t>(content, timer.start);
+    Append<int64_t>(content, timer.end);
+    Append<int32_t>(content, timer.priority);
+    Append<uint32_t>(content, timer.weekdays);
+    Append<int32_t>(content, timer.state);
+  }
+  return WriteFile(m_path + "/snapshot.dat", content.data(), content.size());
+}
+
+bool Snapshot::LoadRecordings(std::string &content)
+{
+  std::vector<char> data;
+  if (!LoadFile(m_path + "/recordings.xml", data))
+    return false;
+  content.assign(data.begin(), data.end());
+  return true;
+}
+
+bool Snapshot::SaveRecordings(const std::string &content)
+{
+  return WriteFile(m_path + "/recordings.xml", content.data(),
+      content.size());
+}
+
+bool Snapshot::WriteFile(const std::string &file, const char *data,
+    size_t size)
+{
+  if (!XBMC->DirectoryExists(m_path.c_str())
+      && !XBMC->CreateDirectory(m_path.c_str()))
+    return false;
+
+  void *fileHandle = XBMC->OpenFileForWrite(file.c_str(), true);
+  if (!fileHandle)
+  {
+    XBMC->Log(LOG_ERROR, "Snapshot: Unable to write %s", file.c_str());
+    return false;
+  }
+  XBMC->WriteFile(fileHandle, data, size);
+  XBMC->CloseFile(fileHandle);
+  return true;
+}
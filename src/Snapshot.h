@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_SNAPSHOT_H
+#define PVR_DVBVIEWER_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+
+class DvbChannel;
+class DvbGroup;
+class DvbTimer;
+
+/*!< @brief persistent copy of the last channels, groups, timers and
+ * recordings. It lets the addon serve Kodi right at startup while the
+ * backend is still unreachable
+ */
+class Snapshot
+{
+public:
+  Snapshot(const std::string &path);
+  /*!< @brief channels of the timers aren't resolved. see channelId */
+  bool Load(std::vector<DvbChannel> &channels, std::vector<DvbGroup> &groups,
+      std::vector<DvbTimer> &timers);
+  bool Save(const std::vector<DvbChannel> &channels,
+      const std::vector<DvbGroup> &groups, const std::vector<DvbTimer> &timers);
+  /*!< @brief recording list as returned by the backend */
+  bool LoadRecordings(std::string &content);
+  bool SaveRecordings(const std::string &content);
+
+private:
+  bool WriteFile(const std::string &file, const char *data, size_t size);
+
+  std::string m_path;
+};
+
+#endif
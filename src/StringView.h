@@ -0,0 +1,122 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_STRINGVIEW_H
+#define PVR_DVBVIEWER_STRINGVIEW_H
+
+#include <cstring>
+#include <string>
+#include <stdint.h>
+
+/*!< @brief non owning reference to a range of characters. Only valid as
+ * long as the referenced data is
+ */
+class StringView
+{
+public:
+  StringView()
+    : m_data(nullptr), m_size(0)
+  {}
+  StringView(const char *data, size_t size)
+    : m_data(data), m_size(size)
+  {}
+  StringView(const char *str)
+    : m_data(str), m_size((str) ? strlen(str) : 0)
+  {}
+  StringView(const std::string &str)
+    : m_data(str.data()), m_size(str.size())
+  {}
+
+  const char *data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  const char *begin() const { return m_data; }
+  const char *end() const { return m_data + m_size; }
+  char operator[](size_t pos) const { return m_data[pos]; }
+
+  StringView substr(size_t pos, size_t count = std::string::npos) const
+  {
+    if (pos > m_size)
+      pos = m_size;
+    if (count > m_size - pos)
+      count = m_size - pos;
+    return StringView(m_data + pos, count);
+  }
+  bool operator==(const StringView &other) const
+  {
+    return (m_size == other.m_size
+        && (m_size == 0 || memcmp(m_data, other.m_data, m_size) == 0));
+  }
+  bool operator!=(const StringView &other) const
+  {
+    return !(*this == other);
+  }
+  std::string str() const
+  {
+    return std::string(m_data, m_size);
+  }
+
+private:
+  const char *m_data;
+  size_t m_size;
+};
+
+/* Hand written number parsers. Unlike atoi/sscanf/istringstream they don't
+ * need a terminated string, a locale or any allocation.
+ */
+namespace StringParser
+{
+  /*!< @brief parse a decimal number. leading whitespace is skipped
+   * @return false if str doesn't start with a digit
+   */
+  template<typename T>
+  inline bool ParseUnsigned(StringView str, T &value)
+  {
+    const char *p = str.begin(), *end = str.end();
+    while (p < end && (*p == ' ' || *p == '\t'))
+      ++p;
+    if (p == end || *p < '0' || *p > '9')
+      return false;
+    T result = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+      result = result * 10 + (*p - '0');
+    value = result;
+    return true;
+  }
+
+  template<typename T>
+  inline bool ParseSigned(StringView str, T &value)
+  {
+    const char *p = str.begin(), *end = str.end();
+    while (p < end && (*p == ' ' || *p == '\t'))
+      ++p;
+    bool negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+'))
+      ++p;
+    T result;
+    if (!ParseUnsigned(StringView(p, end - p), result))
+      return false;
+    value = (negative) ? -result : result;
+    return true;
+  }
+
+  /*!< @brief parse exactly count digits at pos
+   * @return false if there aren't enough digits
+   */
+  inline bool ParseDigits(StringView str, size_t pos, size_t count,
+      int &value)
+  {
+    if (pos + count > str.size())
+      return false;
+    int result = 0;
+    for (size_t i = pos; i < pos + count; ++i)
+    {
+      if (str[i] < '0' || str[i] > '9')
+        return false;
+      result = result * 10 + (str[i] - '0');
+    }
+    value = result;
+    return true;
+  }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "XmlParallelParser.h"
+#include "p8-platform/threads/threads.h"
+#include <algorithm>
+#include <cctype>
+
+using namespace P8PLATFORM;
+
+/* parts smaller than this aren't worth a thread */
+#define MIN_PART_SIZE (64 * 1024)
+
+class XmlParallelParser::Worker
+  : public CThread
+{
+public:
+  Worker(std::function<bool ()> &job)
+    : m_job(job), m_result(false)
+  {}
+  ~Worker(void)
+  {
+    StopThread(0);
+  }
+  bool Result() const { return m_result; }
+
+private:
+  virtual void *Process(void) override
+  {
+    m_result = m_job();
+    return nullptr;
+  }
+
+  std::function<bool ()> &m_job;
+  bool m_result;
+};
+
+XmlParallelParser::XmlParallelParser(const std::string &entryName,
+    unsigned int maxThreads)
+  : m_entryName(entryName), m_maxThreads(std::max(maxThreads, 1u))
+{
+}
+
+std::vector<StringView> XmlParallelParser::Split(const std::string &data)
+{
+  size_t count = std::min<size_t>(m_maxThreads, data.size() / MIN_PART_SIZE);
+
+  std::vector<StringView> parts;
+  const std::string tag = "<" + m_entryName;
+  size_t start = 0;
+  for (size_t i = 1; i < count; ++i)
+  {
+    // the tag name must not just be a prefix of another one
+    size_t pos = std::max(start + 1, data.size() / count * i);
+    while ((pos = data.find(tag, pos)) != std::string::npos)
+    {
+      char next = (pos + tag.size() < data.size()) ? data[pos + tag.size()]
+        : '\0';
+      if (next == '>' || next == '/' || isspace(static_cast<unsigned char>(next)))
+        break;
+      pos += tag.size();
+    }
+    if (pos == std::string::npos)
+      break;
+    parts.push_back(StringView(data.data() + start, pos - start));
+    start = pos;
+  }
+  parts.push_back(StringView(data.data() + start, data.size() - start));
+  return parts;
+}
+
+bool XmlParallelParser::Run(std::vector<std::function<bool ()>> &jobs)
+{
+  // the calling thread takes the first job itself
+  bool result = true;
+  std::vector<Worker *> workers;
+  for (size_t i = 1; i < jobs.size(); ++i)
+  {
+    Worker *worker = new Worker(jobs[i]);
+    if (!worker->CreateThread())
+    {
+      delete worker;
+      result &= jobs[i]();
+      continue;
+    }
+    workers.push_back(worker);
+  }
+
+  result &= jobs.front()();
+  for (auto worker : workers)
+  {
+    worker->StopThread(0);
+    result &= worker->Result();
+    delete worker;
+  }
+  return result;
+}
+
+void XmlParallelParser::SetError(const std::string &error)
+{
+  CLockObject lock(m_mutex);
+  if (m_error.empty())
+    m_error = error;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_XMLPARALLELPARSER_H
+#define PVR_DVBVIEWER_XMLPARALLELPARSER_H
+
+#include "XmlStreamParser.h"
+#include "p8-platform/threads/mutex.h"
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/*!< @brief parses a complete document on up to maxThreads threads. The
+ * document is split in front of entry tags and every part gets its own
+ * XmlStreamParser. Results are returned in document order. Small documents
+ * and a single thread are parsed on the calling thread in one go.
+ */
+class XmlParallelParser
+{
+public:
+  XmlParallelParser(const std::string &entryName, unsigned int maxThreads);
+
+  /*!< @param parseFunc bool (const XmlElement &, T &). Gets called
+   * concurrently for entries of different parts. Returns false to skip the
+   * entry
+   */
+  template<typename T, typename ParseFunc>
+  bool Parse(const std::string &data, ParseFunc parseFunc,
+      std::vector<T> &results)
+  {
+    std::vector<StringView> parts = Split(data);
+    std::vector<std::vector<T>> partResults(parts.size());
+    std::vector<std::function<bool ()>> jobs;
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+      StringView part = parts[i];
+      std::vector<T> &partResult = partResults[i];
+      bool first = (i == 0), last = (i == parts.size() - 1);
+      jobs.push_back([this, part, first, last, &partResult, &parseFunc] ()
+        {
+          return ParsePart(part, first, last, parseFunc, partResult);
+        });
+    }
+
+    results.clear();
+    if (!Run(jobs))
+    {
+      // most likely an entry tag inside of a CDATA section. parts are split
+      // at the wrong place, so try again in one go
+      if (parts.size() == 1)
+        return false;
+      m_error.clear();
+      return ParsePart(StringView(data), true, true, parseFunc, results);
+    }
+
+    for (auto &partResult : partResults)
+      std::move(partResult.begin(), partResult.end(),
+          std::back_inserter(results));
+    return true;
+  }
+
+  const std::string &ErrorDesc() const { return m_error; }
+
+private:
+  class Worker;
+
+  /*!< @brief parts in the middle of the document lack the start tag of the
+   * root element, the end tag or both. Enclosing them in a placeholder
+   * element keeps the checks for truncated documents working. The parser
+   * doesn't compare the names of elements outside of the entries.
+   */
+  template<typename T, typename ParseFunc>
+  bool ParsePart(StringView part, bool first, bool last,
+      ParseFunc &parseFunc, std::vector<T> &results)
+  {
+    static const char partStart[] = "<part>", partEnd[] = "</part>";
+    XmlStreamParser parser(m_entryName, [&] (const XmlElement &xEntry)
+      {
+        T result;
+        if (parseFunc(xEntry, result))
+          results.push_back(std::move(result));
+      });
+    if ((!first && !parser.Feed(partStart, sizeof(partStart) - 1))
+        || !parser.Feed(part.data(), part.size())
+        || (!last && !parser.Feed(partEnd, sizeof(partEnd) - 1))
+        || !parser.Finish())
+    {
+      SetError(parser.ErrorDesc());
+      return false;
+    }
+    return true;
+  }
+
+  /*!< @brief split data in front of entry tags */
+  std::vector<StringView> Split(const std::string &data);
+  /*!< @brief run jobs on the worker threads and wait for them
+   * @return false if a job failed
+   */
+  bool Run(std::vector<std::function<bool ()>> &jobs);
+  void SetError(const std::string &error);
+
+  std::string m_entryName;
+  unsigned int m_maxThreads;
+  std::string m_error;
+  P8PLATFORM::CMutex m_mutex;
+};
+
+#endif
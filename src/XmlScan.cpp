@@ -0,0 +1,99 @@
+#include "XmlScan.h"
+#include <cstring>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XMLSCAN_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define XMLSCAN_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+#ifdef XMLSCAN_SSE2
+inline unsigned int CountTrailingZeros(unsigned int mask)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+#ifdef XMLSCAN_NEON
+inline unsigned int CountTrailingZeros64(uint64_t mask)
+{
+  return __builtin_ctzll(mask);
+}
+#endif
+}
+
+const char *XmlScan::FindAny(const char *begin, const char *end, char a,
+    char b, char c)
+{
+  const char *p = begin;
+#if defined(XMLSCAN_SSE2)
+  const __m128i va = _mm_set1_epi8(a);
+  const __m128i vb = _mm_set1_epi8(b);
+  const __m128i vc = _mm_set1_epi8(c);
+  for (; end - p >= 16; p += 16)
+  {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va),
+          _mm_cmpeq_epi8(chunk, vb)), _mm_cmpeq_epi8(chunk, vc));
+    unsigned int mask = _mm_movemask_epi8(match);
+    if (mask)
+      return p + CountTrailingZeros(mask);
+  }
+#elif defined(XMLSCAN_NEON)
+  const uint8x16_t va = vdupq_n_u8(a);
+  const uint8x16_t vb = vdupq_n_u8(b);
+  const uint8x16_t vc = vdupq_n_u8(c);
+  for (; end - p >= 16; p += 16)
+  {
+    uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+    uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(chunk, va),
+          vceqq_u8(chunk, vb)), vceqq_u8(chunk, vc));
+    // narrow every byte to a nibble. a match gives us 0xF at its position
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+          vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+    if (mask)
+      return p + (CountTrailingZeros64(mask) >> 2);
+  }
+#endif
+  for (; p < end; ++p)
+  {
+    if (*p == a || *p == b || *p == c)
+      return p;
+  }
+  return end;
+}
+
+size_t XmlScan::StripNul(char *data, size_t size)
+{
+  char *end = data + size;
+  char *dst = const_cast<char *>(FindAny(data, end, '\0', '\0', '\0'));
+  if (dst == end)
+    return size;
+
+  // move the runs between NULs down
+  const char *src = dst;
+  while (src < end)
+  {
+    while (src < end && *src == '\0')
+      ++src;
+    const char *next = FindAny(src, end, '\0', '\0', '\0');
+    memmove(dst, src, next - src);
+    dst += next - src;
+    src = next;
+  }
+  return dst - data;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_XMLSCAN_H
+#define PVR_DVBVIEWER_XMLSCAN_H
+
+#include <cstddef>
+
+/*!< @brief vectorized helpers for scanning XML responses. SSE2 on x86,
+ * NEON on ARM and a scalar fallback for everything else
+ */
+namespace XmlScan
+{
+  /*!< @brief remove NUL characters in place
+   * @return the new size
+   */
+  size_t StripNul(char *data, size_t size);
+  /*!< @brief first occurrence of a, b or c
+   * @return end if none was found
+   */
+  const char *FindAny(const char *begin, const char *end, char a, char b,
+      char c);
+}
+
+#endif
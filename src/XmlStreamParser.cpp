@@ -0,0 +1,433 @@
+#include "XmlStreamParser.h"
+#include "XmlScan.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+StringView XmlElement::Name() const
+{
+  return m_parser->View(m_nameOff, m_nameLen);
+}
+
+StringView XmlElement::RawText() const
+{
+  return m_parser->View(m_textOff, m_textLen);
+}
+
+bool XmlElement::Attribute(const char *name, StringView &value) const
+{
+  StringView attrName(name);
+  for (size_t i = m_attrFirst; i < m_attrFirst + m_attrCount; ++i)
+  {
+    auto &attribute = m_parser->m_attributes[i];
+    if (m_parser->View(attribute.nameOff, attribute.nameLen) != attrName)
+      continue;
+    value = m_parser->View(attribute.valueOff, attribute.valueLen);
+    return true;
+  }
+  return false;
+}
+
+bool XmlElement::GetAttribute(const char *name, std::string &value) const
+{
+  StringView raw;
+  if (!Attribute(name, raw))
+    return false;
+  XmlStreamParser::Decode(raw, value);
+  return true;
+}
+
+bool XmlElement::QueryUnsignedAttribute(const char *name,
+    unsigned int *value) const
+{
+  StringView raw;
+  return (Attribute(name, raw) && StringParser::ParseUnsigned(raw, *value));
+}
+
+const XmlElement *XmlElement::FirstChildElement(const char *name) const
+{
+  StringView childName(name);
+  for (int i = m_firstChild; i >= 0; i = m_parser->m_elements[i].m_nextSibling)
+  {
+    const XmlElement &child = m_parser->m_elements[i];
+    if (child.Name() == childName)
+      return &child;
+  }
+  return nullptr;
+}
+
+bool XmlElement::GetView(const char *tag, StringView &value) const
+{
+  const XmlElement *child = FirstChildElement(tag);
+  if (!child)
+    return false;
+  value = child->RawText();
+  return true;
+}
+
+bool XmlElement::GetString(const char *tag, std::string &value) const
+{
+  const XmlElement *child = FirstChildElement(tag);
+  if (!child)
+    return false;
+  StringView raw = child->RawText();
+  if (child->m_escaped)
+    XmlStreamParser::Decode(raw, value);
+  else
+    value.assign(raw.data(), raw.size());
+  return true;
+}
+
+bool XmlElement::GetUInt(const char *tag, unsigned int &value) const
+{
+  StringView raw;
+  return (GetView(tag, raw) && StringParser::ParseUnsigned(raw, value));
+}
+
+bool XmlElement::GetInt(const char *tag, int &value) const
+{
+  StringView raw;
+  return (GetView(tag, raw) && StringParser::ParseSigned(raw, value));
+}
+
+XmlStreamParser::XmlStreamParser(const std::string &entryName,
+    EntryFunc_t entryFunc)
+  : m_entryName(entryName), m_entryFunc(entryFunc), m_pos(0),
+  m_entryStart(std::string::npos), m_outerDepth(0), m_hasRoot(false),
+  m_entries(0)
+{
+}
+
+bool XmlStreamParser::Feed(const char *data, size_t size)
+{
+  if (!m_error.empty())
+    return false;
+
+  // some backend responses contain NUL characters
+  size_t offset = m_buffer.size();
+  m_buffer.append(data, size);
+  m_buffer.resize(offset + XmlScan::StripNul(&m_buffer[offset], size));
+
+  while (m_pos < m_buffer.size())
+  {
+    // text is referenced by its element. nothing to copy here
+    m_pos = m_buffer.find('<', m_pos);
+    if (m_pos == std::string::npos)
+    {
+      m_pos = m_buffer.size();
+      break;
+    }
+    if (!ParseMarkup())
+      break;
+    if (!m_error.empty())
+      return false;
+  }
+
+  // drop what has been consumed. offsets of an unfinished entry are
+  // relative to its start, so they stay valid
+  size_t consumed = (m_stack.empty()) ? m_pos : m_entryStart;
+  m_buffer.erase(0, consumed);
+  m_pos -= consumed;
+  if (!m_stack.empty())
+    m_entryStart = 0;
+  return true;
+}
+
+bool XmlStreamParser::Finish()
+{
+  if (!m_error.empty())
+    return false;
+  // an empty or truncated response is no valid empty list
+  if (!m_hasRoot)
+  {
+    SetError("No root element");
+    return false;
+  }
+  if (!m_stack.empty() || m_outerDepth)
+  {
+    SetError("Unexpected end of document");
+    return false;
+  }
+  return true;
+}
+
+bool XmlStreamParser::ParseMarkup()
+{
+  const char *start = m_buffer.data() + m_pos;
+  size_t avail = m_buffer.size() - m_pos;
+
+  // markup without elements. it stays part of the raw text
+  struct { const char *open, *close; } special[] = {
+    { "<!--",      "-->" },
+    { "<![CDATA[", "]]>" },
+    { "<?",        "?>"  },
+    { "<!",        ">"   },
+  };
+  for (auto &markup : special)
+  {
+    size_t openLen = strlen(markup.open);
+    if (avail < openLen)
+    {
+      if (strncmp(start, markup.open, avail) == 0)
+        return false;
+      continue;
+    }
+    if (strncmp(start, markup.open, openLen) != 0)
+      continue;
+
+    size_t end = m_buffer.find(markup.close, m_pos + openLen);
+    if (end == std::string::npos)
+      return false;
+    if (!m_stack.empty())
+      m_elements[m_stack.back()].m_escaped = true;
+    m_pos = end + strlen(markup.close);
+    return true;
+  }
+
+  // regular tag. '>' is allowed inside attribute values
+  const char *end = start + avail;
+  for (const char *p = start + 1; p < end; ++p)
+  {
+    p = XmlScan::FindAny(p, end, '>', '"', '\'');
+    if (p == end)
+      break;
+    if (*p == '>')
+    {
+      size_t tagEnd = p - m_buffer.data();
+      ParseTag(m_pos, tagEnd);
+      m_pos = tagEnd + 1;
+      return true;
+    }
+    // skip the quoted value
+    p = static_cast<const char *>(memchr(p + 1, *p, end - p - 1));
+    if (!p)
+      break;
+  }
+  return false;
+}
+
+void XmlStreamParser::ParseTag(size_t start, size_t end)
+{
+  const char *tag = m_buffer.data() + start + 1;
+  size_t length = end - start - 1;
+  if (length == 0)
+  {
+    SetError("Empty tag");
+    return;
+  }
+
+  if (tag[0] == '/')
+  {
+    if (m_stack.empty())
+    {
+      if (m_outerDepth)
+        --m_outerDepth;
+      return;
+    }
+    StringView name(tag + 1, length - 1);
+    while (!name.empty()
+        && isspace(static_cast<unsigned char>(name[name.size() - 1])))
+      name = name.substr(0, name.size() - 1);
+
+    XmlElement &element = m_elements[m_stack.back()];
+    if (name != element.Name())
+    {
+      SetError("Mismatched end tag");
+      return;
+    }
+    // text is only of interest for leaf elements
+    if (element.m_firstChild < 0)
+    {
+      element.m_textLen = start - m_entryStart - element.m_textOff;
+      StringView text = element.RawText();
+      if (memchr(text.data(), '&', text.size()))
+        element.m_escaped = true;
+    }
+    m_stack.pop_back();
+    if (m_stack.empty())
+      EntryComplete();
+    return;
+  }
+
+  bool selfClosing = (tag[length - 1] == '/');
+  if (selfClosing)
+    --length;
+
+  const char *tagEnd = tag + length;
+  const char *p = tag;
+  while (p < tagEnd && !isspace(static_cast<unsigned char>(*p)))
+    ++p;
+
+  if (m_stack.empty())
+  {
+    m_hasRoot = true;
+    // ignore everything outside of the entries
+    if (StringView(tag, p - tag) != StringView(m_entryName))
+    {
+      if (!selfClosing)
+        ++m_outerDepth;
+      return;
+    }
+    m_entryStart = start;
+  }
+
+  const char *base = m_buffer.data() + m_entryStart;
+  XmlElement element;
+  element.m_parser      = this;
+  element.m_nameOff     = tag - base;
+  element.m_nameLen     = p - tag;
+  element.m_textOff     = end + 1 - m_entryStart;
+  element.m_textLen     = 0;
+  element.m_escaped     = false;
+  element.m_attrFirst   = m_attributes.size();
+  element.m_attrCount   = 0;
+  element.m_firstChild  = element.m_lastChild = element.m_nextSibling = -1;
+
+  // attributes
+  while (p < tagEnd)
+  {
+    while (p < tagEnd && isspace(static_cast<unsigned char>(*p)))
+      ++p;
+    const char *nameStart = p;
+    while (p < tagEnd && *p != '=' && !isspace(static_cast<unsigned char>(*p)))
+      ++p;
+    if (p == nameStart)
+      break;
+    const char *nameEnd = p;
+    while (p < tagEnd && (*p == '=' || isspace(static_cast<unsigned char>(*p))))
+      ++p;
+    if (p >= tagEnd || (*p != '"' && *p != '\''))
+    {
+      SetError("Malformed attribute");
+      return;
+    }
+    char quote = *p++;
+    const char *valueStart = p;
+    while (p < tagEnd && *p != quote)
+      ++p;
+
+    XmlAttribute attribute;
+    attribute.nameOff  = nameStart - base;
+    attribute.nameLen  = nameEnd - nameStart;
+    attribute.valueOff = valueStart - base;
+    attribute.valueLen = p - valueStart;
+    m_attributes.push_back(attribute);
+    ++element.m_attrCount;
+    ++p;
+  }
+
+  int index = m_elements.size();
+  if (!m_stack.empty())
+  {
+    XmlElement &parent = m_elements[m_stack.back()];
+    if (parent.m_lastChild >= 0)
+      m_elements[parent.m_lastChild].m_nextSibling = index;
+    else
+      parent.m_firstChild = index;
+    parent.m_lastChild = index;
+  }
+  m_elements.push_back(element);
+
+  if (!selfClosing)
+    m_stack.push_back(index);
+  else if (m_stack.empty())
+    EntryComplete();
+}
+
+void XmlStreamParser::EntryComplete()
+{
+  ++m_entries;
+  m_entryFunc(m_elements.front());
+  // keep the capacity for the next entry
+  m_elements.clear();
+  m_attributes.clear();
+  m_entryStart = std::string::npos;
+}
+
+void XmlStreamParser::Decode(StringView raw, std::string &value)
+{
+  value.clear();
+  const char *data = raw.begin(), *end = raw.end();
+  while (data < end)
+  {
+    const char *special = XmlScan::FindAny(data, end, '&', '<', '<');
+    value.append(data, special);
+    if (special == end)
+      return;
+
+    if (*special == '<')
+    {
+      // content of CDATA sections is taken as is, comments are dropped
+      bool cdata = (StringView(special, end - special).substr(0, 9)
+          == StringView("<![CDATA["));
+      const char *close = (cdata) ? "]]>" : "-->";
+      const char *content = special + ((cdata) ? 9 : 4);
+      const char *closePos = std::search(content, end, close, close + 3);
+      if (cdata)
+        value.append(content, closePos);
+      data = (closePos == end) ? end : closePos + 3;
+      continue;
+    }
+
+    const char *semicolon = static_cast<const char *>(memchr(special, ';',
+          end - special));
+    if (!semicolon)
+    {
+      value.append(special, end);
+      return;
+    }
+
+    StringView entity(special + 1, semicolon - special - 1);
+    unsigned long code = 0;
+    if (entity == "lt")
+      code = '<';
+    else if (entity == "gt")
+      code = '>';
+    else if (entity == "amp")
+      code = '&';
+    else if (entity == "quot")
+      code = '"';
+    else if (entity == "apos")
+      code = '\'';
+    else if (entity.size() > 2 && entity[0] == '#'
+        && (entity[1] == 'x' || entity[1] == 'X'))
+    {
+      for (size_t i = 2; i < entity.size() && isxdigit(
+            static_cast<unsigned char>(entity[i])); ++i)
+        code = code * 16 + (isdigit(static_cast<unsigned char>(entity[i]))
+          ? entity[i] - '0' : tolower(entity[i]) - 'a' + 10);
+    }
+    else if (entity.size() > 1 && entity[0] == '#')
+      StringParser::ParseUnsigned(entity.substr(1), code);
+
+    if (code == 0)
+      value.append(special, semicolon + 1); // unknown. keep as is
+    else if (code < 0x80)
+      value += static_cast<char>(code);
+    else if (code < 0x800)
+    {
+      value += static_cast<char>(0xC0 | (code >> 6));
+      value += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000)
+    {
+      value += static_cast<char>(0xE0 | (code >> 12));
+      value += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+      value += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else
+    {
+      value += static_cast<char>(0xF0 | (code >> 18));
+      value += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+      value += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+      value += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    data = semicolon + 1;
+  }
+}
+
+void XmlStreamParser::SetError(const char *error)
+{
+  if (m_error.empty())
+    m_error = error;
+}
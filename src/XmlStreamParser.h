@@ -0,0 +1,117 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_XMLSTREAMPARSER_H
+#define PVR_DVBVIEWER_XMLSTREAMPARSER_H
+
+#include "StringView.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+class XmlStreamParser;
+
+/*!< @brief element of the entry currently being parsed. It refers to the
+ * buffer of the parser and is only valid inside the entry callback. Views
+ * are raw (entities aren't decoded). Strings are decoded.
+ */
+class XmlElement
+{
+public:
+  StringView Name() const;
+  /*!< @brief text of a leaf element */
+  StringView RawText() const;
+  /*!< @return false if the attribute doesn't exist */
+  bool Attribute(const char *name, StringView &value) const;
+  bool GetAttribute(const char *name, std::string &value) const;
+  bool QueryUnsignedAttribute(const char *name, unsigned int *value) const;
+  const XmlElement *FirstChildElement(const char *name) const;
+  /*!< @brief text of the child element tag */
+  bool GetView(const char *tag, StringView &value) const;
+  bool GetString(const char *tag, std::string &value) const;
+  bool GetUInt(const char *tag, unsigned int &value) const;
+  bool GetInt(const char *tag, int &value) const;
+
+private:
+  friend class XmlStreamParser;
+
+  const XmlStreamParser *m_parser;
+  /* offsets are relative to the start of the entry */
+  size_t m_nameOff, m_nameLen;
+  size_t m_textOff, m_textLen;
+  /*!< @brief text contains entities or CDATA sections */
+  bool m_escaped;
+  size_t m_attrFirst, m_attrCount;
+  /*!< @brief indexes of related elements. -1 if none */
+  int m_firstChild, m_lastChild, m_nextSibling;
+};
+
+/*!< @brief incremental parser for XML documents consisting of a list of
+ * entries. Data can be fed in chunks as it arrives. Each entry element is
+ * handed over as soon as it's complete. Memory usage is bound by the size
+ * of a single entry and apart from growing its buffers the parser doesn't
+ * allocate.
+ */
+class XmlStreamParser
+{
+public:
+  typedef std::function<void (const XmlElement &)> EntryFunc_t;
+
+  XmlStreamParser(const std::string &entryName, EntryFunc_t entryFunc);
+  /*!< @return false on malformed input */
+  bool Feed(const char *data, size_t size);
+  /*!< @brief signals the end of the document
+   * @return false if the document is incomplete or has no root element
+   */
+  bool Finish();
+  const std::string &ErrorDesc() const { return m_error; }
+  unsigned int Entries() const { return m_entries; }
+
+  /*!< @brief decode entities and CDATA sections of raw text */
+  static void Decode(StringView raw, std::string &value);
+
+private:
+  friend class XmlElement;
+
+  struct XmlAttribute
+  {
+    size_t nameOff, nameLen;
+    size_t valueOff, valueLen;
+  };
+
+  /*!< @return false if more data is required */
+  bool ParseMarkup();
+  void ParseTag(size_t start, size_t end);
+  void EntryComplete();
+  void SetError(const char *error);
+  StringView View(size_t offset, size_t length) const
+  {
+    return StringView(m_buffer.data() + m_entryStart + offset, length);
+  }
+
+  std::string m_entryName;
+  EntryFunc_t m_entryFunc;
+
+  /*!< @brief data not yet consumed. An unfinished entry is kept completely */
+  std::string m_buffer;
+  /*!< @brief position of the next byte to parse */
+  size_t m_pos;
+  /*!< @brief position of the entry inside m_buffer */
+  size_t m_entryStart;
+
+  /*!< @brief elements and attributes of the current entry. They're reused
+   * for every entry
+   */
+  std::vector<XmlElement> m_elements;
+  std::vector<XmlAttribute> m_attributes;
+  /*!< @brief open elements */
+  std::vector<int> m_stack;
+  /*!< @brief open elements enclosing the entries */
+  unsigned int m_outerDepth;
+  /*!< @brief the root element has been opened */
+  bool m_hasRoot;
+
+  unsigned int m_entries;
+  std::string m_error;
+};
+
+#endif
@@ -44,10 +44,20 @@ bool           g_useFavourites        = false;
 bool           g_useFavouritesFile    = false;
 std::string    g_favouritesFile       = "";
 DvbRecording::Grouping g_groupRecordings = DvbRecording::Grouping::DISABLED;
+int            g_readAheadSize        = DEFAULT_READAHEAD_SIZE;
+int            g_readAheadConnections = DEFAULT_READAHEAD_CONNS;
+bool           g_directAccess         = false;
+std::string    g_recordingsPath       = "";
+int            g_recordingCacheSize   = DEFAULT_RECCACHE_SIZE;
+bool           g_cacheRecentRecordings = true;
+int            g_epgCacheTTL          = DEFAULT_EPGCACHE_TTL;
+bool           g_bulkEPG              = true;
+int            g_epgPrefetchConnections = DEFAULT_EPGPREFETCH_CONNS;
 Timeshift      g_timeshift            = Timeshift::OFF;
 std::string    g_timeshiftBufferPath  = DEFAULT_TSBUFFERPATH;
 PrependOutline g_prependOutline       = PrependOutline::IN_EPG;
 bool           g_lowPerformance       = false;
+bool           g_parallelParsing      = false;
 Transcoding    g_transcoding          = Transcoding::OFF;
 std::string    g_transcodingParams    = "";
 
@@ -94,6 +104,24 @@ void ADDON_ReadSettings(void)
   if (!XBMC->GetSetting("grouprecordings", &g_groupRecordings))
     g_groupRecordings = DvbRecording::Grouping::DISABLED;
 
+  if (!XBMC->GetSetting("readahead", &g_readAheadSize))
+    g_readAheadSize = DEFAULT_READAHEAD_SIZE;
+
+  if (!XBMC->GetSetting("readaheadconnections", &g_readAheadConnections))
+    g_readAheadConnections = DEFAULT_READAHEAD_CONNS;
+
+  if (!XBMC->GetSetting("directaccess", &g_directAccess))
+    g_directAccess = false;
+
+  if (g_directAccess && XBMC->GetSetting("recordingspath", buffer))
+    g_recordingsPath = buffer;
+
+  if (!XBMC->GetSetting("cachesize", &g_recordingCacheSize))
+    g_recordingCacheSize = DEFAULT_RECCACHE_SIZE;
+
+  if (!XBMC->GetSetting("cacherecent", &g_cacheRecentRecordings))
+    g_cacheRecentRecordings = true;
+
   if (!XBMC->GetSetting("timeshift", &g_timeshift))
     g_timeshift = Timeshift::OFF;
 
@@ -106,6 +134,18 @@ void ADDON_ReadSettings(void)
   if (!XBMC->GetSetting("lowperformance", &g_lowPerformance))
     g_lowPerformance = false;
 
+  if (!XBMC->GetSetting("parallelparsing", &g_parallelParsing))
+    g_parallelParsing = false;
+
+  if (!XBMC->GetSetting("epgcachettl", &g_epgCacheTTL))
+    g_epgCacheTTL = DEFAULT_EPGCACHE_TTL;
+
+  if (!XBMC->GetSetting("bulkepg", &g_bulkEPG))
+    g_bulkEPG = true;
+
+  if (!XBMC->GetSetting("epgprefetch", &g_epgPrefetchConnections))
+    g_epgPrefetchConnections = DEFAULT_EPGPREFETCH_CONNS;
+
   if (!XBMC->GetSetting("transcoding", &g_transcoding))
     g_transcoding = Transcoding::OFF;
 
@@ -136,11 +176,24 @@ void ADDON_ReadSettings(void)
   /* recordings tab */
   if (g_groupRecordings != DvbRecording::Grouping::DISABLED)
     XBMC->Log(LOG_DEBUG, "Group recordings: %d", g_groupRecordings);
+  XBMC->Log(LOG_DEBUG, "Read-ahead buffer: %d MB", g_readAheadSize);
+  if (g_readAheadSize > 0)
+    XBMC->Log(LOG_DEBUG, "Read-ahead connections: %d", g_readAheadConnections);
+  if (g_directAccess)
+    XBMC->Log(LOG_DEBUG, "Local recordings path: %s", g_recordingsPath.c_str());
+  XBMC->Log(LOG_DEBUG, "Recording cache: %d MB", g_recordingCacheSize);
+  if (g_recordingCacheSize > 0)
+    XBMC->Log(LOG_DEBUG, "Cache recently played recordings: %s",
+        (g_cacheRecentRecordings) ? "yes" : "no");
 
   /* advanced tab */
   if (g_prependOutline != PrependOutline::NEVER)
     XBMC->Log(LOG_DEBUG, "Prepend outline: %d", g_prependOutline);
   XBMC->Log(LOG_DEBUG, "Low performance mode: %s", (g_lowPerformance) ? "yes" : "no");
+  XBMC->Log(LOG_DEBUG, "Parallel parsing: %s", (g_parallelParsing) ? "yes" : "no");
+  XBMC->Log(LOG_DEBUG, "EPG cache lifetime: %d hours", g_epgCacheTTL);
+  XBMC->Log(LOG_DEBUG, "Bulk EPG requests: %s", (g_bulkEPG) ? "yes" : "no");
+  XBMC->Log(LOG_DEBUG, "EPG prefetch connections: %d", g_epgPrefetchConnections);
   XBMC->Log(LOG_DEBUG, "Transcoding: %d", g_transcoding);
   if (g_transcoding != Transcoding::OFF)
     XBMC->Log(LOG_DEBUG, "Transcoding params: %s", g_transcodingParams.c_str());
@@ -166,6 +219,17 @@ ADDON_STATUS ADDON_Create(void *hdl, void *props)
   ADDON_ReadSettings();
 
   DvbData = new Dvb();
+
+  if (g_recordingCacheSize > 0)
+  {
+    PVR_MENUHOOK hook;
+    memset(&hook, 0, sizeof(PVR_MENUHOOK));
+    hook.iHookId            = MENUHOOK_CACHE_RECORDING;
+    hook.iLocalizedStringId = 30069;
+    hook.category           = PVR_MENUHOOK_RECORDING;
+    PVR->AddMenuHook(&hook);
+  }
+
   m_curStatus = ADDON_STATUS_OK;
   return m_curStatus;
 }
@@ -246,6 +310,33 @@ ADDON_STATUS ADDON_SetSetting(const char *settingName, const void *settingValue)
     if (g_groupRecordings != *(const DvbRecording::Grouping *)settingValue)
       return ADDON_STATUS_NEED_RESTART;
   }
+  else if (sname == "readahead")
+  {
+    // takes effect on the next recording playback
+    g_readAheadSize = *(int *)settingValue;
+  }
+  else if (sname == "readaheadconnections")
+  {
+    g_readAheadConnections = *(int *)settingValue;
+  }
+  else if (sname == "directaccess")
+  {
+    if (g_directAccess != *(bool *)settingValue)
+      return ADDON_STATUS_NEED_RESTART;
+  }
+  else if (sname == "recordingspath")
+  {
+    g_recordingsPath = (const char *)settingValue;
+  }
+  else if (sname == "cachesize")
+  {
+    if (g_recordingCacheSize != *(int *)settingValue)
+      return ADDON_STATUS_NEED_RESTART;
+  }
+  else if (sname == "cacherecent")
+  {
+    g_cacheRecentRecordings = *(bool *)settingValue;
+  }
   else if (sname == "timeshift")
   {
     Timeshift newValue = *(const Timeshift *)settingValue;
@@ -283,6 +374,24 @@ ADDON_STATUS ADDON_SetSetting(const char *settingName, const void *settingValue)
     if (g_lowPerformance != *(bool *)settingValue)
       return ADDON_STATUS_NEED_RESTART;
   }
+  else if (sname == "parallelparsing")
+  {
+    g_parallelParsing = *(bool *)settingValue;
+  }
+  else if (sname == "epgcachettl")
+  {
+    if (g_epgCacheTTL != *(int *)settingValue)
+      return ADDON_STATUS_NEED_RESTART;
+  }
+  else if (sname == "bulkepg")
+  {
+    g_bulkEPG = *(bool *)settingValue;
+  }
+  else if (sname == "epgprefetch")
+  {
+    if (g_epgPrefetchConnections != *(int *)settingValue)
+      return ADDON_STATUS_NEED_RESTART;
+  }
   else if (sname == "transcoding")
   {
     g_transcoding = *(const Transcoding *)settingValue;
@@ -388,7 +497,7 @@ PVR_ERROR GetDriveSpace(long long *total, long long *used)
 /* channel functions */
 PVR_ERROR GetChannels(ADDON_HANDLE handle, bool radio)
 {
-  return (DvbData && DvbData->IsConnected()
+  return (DvbData && DvbData->HasData()
       && DvbData->GetChannels(handle, radio))
     ? PVR_ERROR_NO_ERROR : PVR_ERROR_SERVER_ERROR;
 }
@@ -403,7 +512,7 @@ PVR_ERROR GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANNEL &channel,
 
 int GetChannelsAmount(void)
 {
-  if (!DvbData || !DvbData->IsConnected())
+  if (!DvbData || !DvbData->HasData())
     return 0;
 
   return DvbData->GetChannelsAmount();
@@ -412,7 +521,7 @@ int GetChannelsAmount(void)
 /* channel group functions */
 int GetChannelGroupsAmount(void)
 {
-  if (!DvbData || !DvbData->IsConnected())
+  if (!DvbData || !DvbData->HasData())
     return 0;
 
   return DvbData->GetChannelGroupsAmount();
@@ -420,7 +529,7 @@ int GetChannelGroupsAmount(void)
 
 PVR_ERROR GetChannelGroups(ADDON_HANDLE handle, bool radio)
 {
-  return (DvbData && DvbData->IsConnected()
+  return (DvbData && DvbData->HasData()
       && DvbData->GetChannelGroups(handle, radio))
     ? PVR_ERROR_NO_ERROR : PVR_ERROR_SERVER_ERROR;
 }
@@ -428,7 +537,7 @@ PVR_ERROR GetChannelGroups(ADDON_HANDLE handle, bool radio)
 PVR_ERROR GetChannelGroupMembers(ADDON_HANDLE handle,
     const PVR_CHANNEL_GROUP &group)
 {
-  return (DvbData && DvbData->IsConnected()
+  return (DvbData && DvbData->HasData()
       && DvbData->GetChannelGroupMembers(handle, group))
     ? PVR_ERROR_NO_ERROR : PVR_ERROR_SERVER_ERROR;
 }
@@ -442,7 +551,7 @@ PVR_ERROR GetTimerTypes(PVR_TIMER_TYPE types[], int *size)
 
 int GetTimersAmount(void)
 {
-  if (!DvbData || !DvbData->IsConnected())
+  if (!DvbData || !DvbData->HasData())
     return 0;
 
   return DvbData->GetTimersAmount();
@@ -451,7 +560,7 @@ int GetTimersAmount(void)
 PVR_ERROR GetTimers(ADDON_HANDLE handle)
 {
   /* TODO: Change implementation to get support for the timer features introduced with PVR API 1.9.7 */
-  return (DvbData && DvbData->IsConnected() && DvbData->GetTimers(handle))
+  return (DvbData && DvbData->HasData() && DvbData->GetTimers(handle))
     ? PVR_ERROR_NO_ERROR : PVR_ERROR_SERVER_ERROR;
 }
 
@@ -567,7 +676,7 @@ void PauseStream(bool paused)
 /* recording stream functions */
 int GetRecordingsAmount(bool _UNUSED(deleted))
 {
-  if (!DvbData || !DvbData->IsConnected())
+  if (!DvbData || !DvbData->HasData())
     return PVR_ERROR_SERVER_ERROR;
 
   return DvbData->GetRecordingsAmount();
@@ -575,7 +684,7 @@ int GetRecordingsAmount(bool _UNUSED(deleted))
 
 PVR_ERROR GetRecordings(ADDON_HANDLE handle, bool _UNUSED(deleted))
 {
-  return (DvbData && DvbData->IsConnected()
+  return (DvbData && DvbData->HasData()
       && DvbData->GetRecordings(handle))
     ? PVR_ERROR_NO_ERROR : PVR_ERROR_SERVER_ERROR;
 }
@@ -592,13 +701,15 @@ bool OpenRecordedStream(const PVR_RECORDING &recording)
   if (recReader)
     SAFE_DELETE(recReader);
   recReader = DvbData->OpenRecordedStream(recording);
-  return recReader->Start();
+  return (recReader != nullptr);
 }
 
 void CloseRecordedStream(void)
 {
   if (recReader)
     SAFE_DELETE(recReader);
+  if (DvbData)
+    DvbData->CloseRecordedStream();
 }
 
 int ReadRecordedStream(unsigned char *buffer, unsigned int size)
@@ -625,10 +736,28 @@ long long LengthRecordedStream(void)
   return recReader->Length();
 }
 
+bool SeekTime(double time, bool backwards, double *startpts)
+{
+  if (!recReader)
+    return false;
+
+  return recReader->SeekTime(time, backwards, startpts);
+}
+
+PVR_ERROR CallMenuHook(const PVR_MENUHOOK &menuhook,
+    const PVR_MENUHOOK_DATA &item)
+{
+  if (menuhook.iHookId != MENUHOOK_CACHE_RECORDING
+      || item.cat != PVR_MENUHOOK_RECORDING)
+    return PVR_ERROR_NOT_IMPLEMENTED;
+
+  return (DvbData && DvbData->CacheRecording(item.data.recording))
+    ? PVR_ERROR_NO_ERROR : PVR_ERROR_FAILED;
+}
+
 /** UNUSED API FUNCTIONS */
 PVR_ERROR GetStreamProperties(PVR_STREAM_PROPERTIES*) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR GetChannelStreamProperties(const PVR_CHANNEL*, PVR_NAMED_VALUE*, unsigned int*) { return PVR_ERROR_NOT_IMPLEMENTED; }
-PVR_ERROR CallMenuHook(const PVR_MENUHOOK&, const PVR_MENUHOOK_DATA&) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR DeleteChannel(const PVR_CHANNEL&) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR RenameChannel(const PVR_CHANNEL&) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR OpenDialogChannelScan(void) { return PVR_ERROR_NOT_IMPLEMENTED; }
@@ -651,7 +780,6 @@ PVR_ERROR SetEPGTimeFrame(int) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR IsEPGTagPlayable(const EPG_TAG*, bool*) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR IsEPGTagRecordable(const EPG_TAG*, bool*) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR GetEPGTagStreamProperties(const EPG_TAG*, PVR_NAMED_VALUE*, unsigned int*) { return PVR_ERROR_NOT_IMPLEMENTED; }
-bool SeekTime(double, bool, double*) { return false; }
 void SetSpeed(int) {};
 PVR_ERROR GetDescrambleInfo(PVR_DESCRAMBLE_INFO*) { return PVR_ERROR_NOT_IMPLEMENTED; }
 }
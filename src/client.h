@@ -55,7 +55,15 @@
 
 #define DEFAULT_HOST             "127.0.0.1"
 #define DEFAULT_WEB_PORT         8089
-#define DEFAULT_TSBUFFERPATH     "special://userdata/addon_data/pvr.dvbviewer"
+#define ADDON_DATA_PATH          "special://userdata/addon_data/pvr.dvbviewer"
+#define DEFAULT_TSBUFFERPATH     ADDON_DATA_PATH
+#define DEFAULT_READAHEAD_SIZE   4
+#define DEFAULT_READAHEAD_CONNS  1
+#define DEFAULT_RECCACHE_SIZE    0
+#define DEFAULT_EPGCACHE_TTL     12
+#define DEFAULT_EPGPREFETCH_CONNS 2
+
+#define MENUHOOK_CACHE_RECORDING 1
 
 enum class Timeshift
   : int // same type as addon settings
@@ -93,10 +101,20 @@ extern bool           g_useFavourites;
 extern bool           g_useFavouritesFile;
 extern std::string    g_favouritesFile;
 extern DvbRecording::Grouping g_groupRecordings;
+extern int            g_readAheadSize;
+extern int            g_readAheadConnections;
+extern bool           g_directAccess;
+extern std::string    g_recordingsPath;
+extern int            g_recordingCacheSize;
+extern bool           g_cacheRecentRecordings;
+extern int            g_epgCacheTTL;
+extern bool           g_bulkEPG;
+extern int            g_epgPrefetchConnections;
 extern Timeshift      g_timeshift;
 extern std::string    g_timeshiftBufferPath;
 extern PrependOutline g_prependOutline;
 extern bool           g_lowPerformance;
+extern bool           g_parallelParsing;
 extern Transcoding    g_transcoding;
 extern std::string    g_transcodingParams;
 
@@ -0,0 +1,200 @@
+/* Resolves the channels of a sync with 2000 channels, 5000 recordings and
+ * their favourites and timers. The linear search Dvb::GetChannel used to do
+ * is compared with hash indexes by backend id and backend name, built the
+ * same way as Dvb::IndexChannels does. Both must find the same channels.
+ */
+#include "DvbData.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <unordered_map>
+
+#define CHANNELS   2000
+#define RECORDINGS 5000
+#define TIMERS     500
+#define RUNS       5
+
+#define BACKEND_ID_BASE  1000000000000000000ULL
+/* every third channel has a second audio track with its own backend id */
+#define AUDIO_ID_OFFSET  5000000000ULL
+
+/*!< @brief best time of RUNS runs in ms */
+static double Measure(const std::function<void ()> &func)
+{
+  double best = 0.0;
+  for (unsigned int i = 0; i < RUNS; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+    if (!i || elapsed.count() < best)
+      best = elapsed.count();
+  }
+  return best;
+}
+
+static std::vector<DvbChannel> Channels()
+{
+  std::vector<DvbChannel> channels(CHANNELS);
+  char name[64];
+  for (unsigned int i = 0; i < CHANNELS; ++i)
+  {
+    DvbChannel &channel = channels[i];
+    channel.id = i + 1;
+    channel.backendIds.push_back(BACKEND_ID_BASE + i);
+    if (i % 3 == 0)
+      channel.backendIds.push_back(BACKEND_ID_BASE + AUDIO_ID_OFFSET + i);
+    snprintf(name, sizeof(name), "Channel %04u HD", i);
+    channel.name = channel.backendName = name;
+  }
+  return channels;
+}
+
+/* what a sync looks up: the favourites and timers by backend id, the
+ * recordings by backend name. some of them refer to deleted channels
+ */
+struct Lookups
+{
+  std::vector<uint64_t> backendIds;
+  std::vector<std::string> backendNames;
+};
+
+static Lookups SyncLookups()
+{
+  Lookups lookups;
+  for (unsigned int i = 0; i < CHANNELS; i += 10)
+    lookups.backendIds.push_back(BACKEND_ID_BASE + i);
+  for (unsigned int i = 0; i < TIMERS; ++i)
+  {
+    unsigned int channel = (i * 7919) % (CHANNELS + 100);
+    lookups.backendIds.push_back(BACKEND_ID_BASE
+        + ((i % 4 == 0) ? AUDIO_ID_OFFSET : 0) + channel);
+  }
+  char name[64];
+  for (unsigned int i = 0; i < RECORDINGS; ++i)
+  {
+    snprintf(name, sizeof(name), "Channel %04u HD", (i * 104729)
+        % (CHANNELS + 100));
+    lookups.backendNames.push_back(name);
+  }
+  return lookups;
+}
+
+class LinearLookup
+{
+public:
+  LinearLookup(std::vector<DvbChannel> &channels)
+    : m_channels(channels)
+  {}
+
+  DvbChannel *GetChannel(std::function<bool (const DvbChannel*)> func)
+  {
+    for (auto &channel : m_channels)
+    {
+      if (func(&channel))
+        return &channel;
+    }
+    return nullptr;
+  }
+
+  DvbChannel *ByBackendId(uint64_t backendId)
+  {
+    return GetChannel([&] (const DvbChannel *channel)
+        {
+          return std::find(channel->backendIds.begin(),
+              channel->backendIds.end(), backendId)
+            != channel->backendIds.end();
+        });
+  }
+
+  DvbChannel *ByBackendName(const std::string &backendName)
+  {
+    return GetChannel([&] (const DvbChannel *channel)
+        {
+          return (channel->backendName == backendName);
+        });
+  }
+
+private:
+  std::vector<DvbChannel> &m_channels;
+};
+
+class IndexedLookup
+{
+public:
+  IndexedLookup(std::vector<DvbChannel> &channels)
+    : m_channels(channels)
+  {
+    for (unsigned int index = 0; index < m_channels.size(); ++index)
+    {
+      const DvbChannel &channel = m_channels[index];
+      for (uint64_t backendId : channel.backendIds)
+        m_byBackendId.emplace(backendId, index);
+      m_byBackendName.emplace(channel.backendName, index);
+    }
+  }
+
+  DvbChannel *ByBackendId(uint64_t backendId)
+  {
+    auto it = m_byBackendId.find(backendId);
+    return (it != m_byBackendId.end()) ? &m_channels[it->second] : nullptr;
+  }
+
+  DvbChannel *ByBackendName(const std::string &backendName)
+  {
+    auto it = m_byBackendName.find(backendName);
+    return (it != m_byBackendName.end()) ? &m_channels[it->second] : nullptr;
+  }
+
+private:
+  std::vector<DvbChannel> &m_channels;
+  std::unordered_map<uint64_t, unsigned int> m_byBackendId;
+  std::unordered_map<std::string, unsigned int> m_byBackendName;
+};
+
+template<typename T>
+static void Resolve(T &lookup, const Lookups &lookups,
+    std::vector<DvbChannel *> &result)
+{
+  result.clear();
+  for (uint64_t backendId : lookups.backendIds)
+    result.push_back(lookup.ByBackendId(backendId));
+  for (auto &backendName : lookups.backendNames)
+    result.push_back(lookup.ByBackendName(backendName));
+}
+
+int main()
+{
+  std::vector<DvbChannel> channels = Channels();
+  Lookups lookups = SyncLookups();
+  std::vector<DvbChannel *> linear, indexed;
+
+  double linearTime = Measure([&] ()
+  {
+    LinearLookup lookup(channels);
+    Resolve(lookup, lookups, linear);
+  });
+  double indexedTime = Measure([&] ()
+  {
+    IndexedLookup lookup(channels);
+    Resolve(lookup, lookups, indexed);
+  });
+
+  unsigned int found = 0;
+  for (auto channel : indexed)
+    found += (channel != nullptr);
+  printf("%u channels, %zu lookups (%u found): linear %.2f ms, "
+      "indexed %.2f ms including the index, %.0fx\n", CHANNELS,
+      indexed.size(), found, linearTime, indexedTime,
+      linearTime / indexedTime);
+
+  if (linear != indexed)
+  {
+    printf("the index found different channels than the linear search\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/* Compares LocalTime against the C library for every quarter of an hour of
+ * a few years in several timezones. Unique local times must match mktime.
+ * Repeated times must resolve to their first occurrence and skipped times
+ * must be moved forward by the length of the gap.
+ */
+#include "LocalTime.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#define STEP       (15 * 60)
+#define FIRST_YEAR 2009
+#define LAST_YEAR  2012
+
+static int64_t DaysFromCivil(int64_t year, int month, int day)
+{
+  year -= (month <= 2);
+  int64_t era = ((year >= 0) ? year : year - 399) / 400;
+  int64_t yoe = year - era * 400;
+  int64_t doy = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+static int64_t LocalSeconds(const struct tm &tm)
+{
+  return DaysFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) * 86400
+    + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+}
+
+static unsigned int TestZone(const char *zone)
+{
+  setenv("TZ", zone, 1);
+  tzset();
+
+  /* every instant of the range and the local time it maps to */
+  int64_t first = DaysFromCivil(FIRST_YEAR, 1, 1) * 86400;
+  int64_t last  = DaysFromCivil(LAST_YEAR + 1, 1, 1) * 86400;
+  std::map<int64_t, std::vector<time_t>> instants;
+  for (int64_t t = first - 2 * 86400; t < last + 2 * 86400; t += STEP)
+  {
+    time_t tt = static_cast<time_t>(t);
+    struct tm tm;
+    localtime_r(&tt, &tm);
+    instants[LocalSeconds(tm)].push_back(tt);
+  }
+
+  LocalTime localTime;
+  unsigned int failures = 0, repeated = 0, skipped = 0;
+  long lastOffset = 0;
+  for (int64_t local = first; local < last; local += STEP)
+  {
+    int64_t days = local / 86400;
+    int secs = static_cast<int>(local - days * 86400);
+    time_t tt = static_cast<time_t>(days * 86400);
+    struct tm date;
+    gmtime_r(&tt, &date);
+
+    time_t result = localTime.ToTime(date.tm_year + 1900, date.tm_mon + 1,
+        date.tm_mday, secs / 3600, secs / 60 % 60, secs % 60);
+
+    time_t expected;
+    auto it = instants.find(local);
+    if (it == instants.end())
+    {
+      expected = static_cast<time_t>(local - lastOffset);
+      ++skipped;
+    }
+    else
+    {
+      expected = it->second.front();
+      lastOffset = static_cast<long>(local - expected);
+      if (it->second.size() > 1)
+        ++repeated;
+      else
+      {
+        // a fresh struct for every call. mktime must agree on unique times
+        struct tm tm = date;
+        tm.tm_hour  = secs / 3600;
+        tm.tm_min   = secs / 60 % 60;
+        tm.tm_sec   = secs % 60;
+        tm.tm_isdst = -1;
+        if (mktime(&tm) != expected)
+        {
+          printf("%s: reference mismatch at %04d-%02d-%02d %02d:%02d\n",
+              zone, date.tm_year + 1900, date.tm_mon + 1, date.tm_mday,
+              secs / 3600, secs / 60 % 60);
+          ++failures;
+        }
+      }
+    }
+
+    if (result != expected)
+    {
+      if (failures < 10)
+        printf("%s: %04d-%02d-%02d %02d:%02d gave %lld, expected %lld\n",
+            zone, date.tm_year + 1900, date.tm_mon + 1, date.tm_mday,
+            secs / 3600, secs / 60 % 60, static_cast<long long>(result),
+            static_cast<long long>(expected));
+      ++failures;
+    }
+  }
+
+  printf("%s: %u repeated, %u skipped, %u failures\n", zone, repeated,
+      skipped, failures);
+  return failures;
+}
+
+int main()
+{
+  const char *zones[] = { "UTC", "Europe/Berlin", "America/New_York",
+    "America/Sao_Paulo", "Australia/Lord_Howe", "Asia/Kathmandu" };
+  unsigned int failures = 0;
+  for (const char *zone : zones)
+    failures += TestZone(zone);
+  return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+/* Reads a throttled fake recording through ReadAheadBuffer with the default
+ * single connection. The data must arrive unchanged and in order, no matter
+ * how the reads are sized, where the reader seeks to and whether the source
+ * returns short reads or is slower than the reader.
+ */
+#include "ReadAheadBuffer.h"
+#include "client.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#define BUFFER_SIZE   (256 * 1024)
+#define SOURCE_LENGTH (3 * 1024 * 1024 + 123)
+
+/* Kodi isn't around. Only logging is used on the sequential path */
+class LogHelper
+  : public ADDON::CHelper_libXBMC_addon
+{
+public:
+  LogHelper()
+  {
+    XBMC_log = Print;
+  }
+
+private:
+  static void Print(void *handle, void *cb, const ADDON::addon_log_t loglevel,
+      const char *msg)
+  {
+    if (getenv("READAHEAD_TEST_VERBOSE"))
+      printf("  %s\n", msg);
+  }
+};
+
+ADDON::CHelper_libXBMC_addon *XBMC = nullptr;
+
+static unsigned char Pattern(uint64_t position)
+{
+  return static_cast<unsigned char>((position * 7 + (position >> 9)) & 0xFF);
+}
+
+/* a recording behind a slow connection. every read sleeps and may return
+ * less than asked for, just like a HTTP stream does
+ */
+class FakeSource
+{
+public:
+  FakeSource(unsigned int delayUs, unsigned int maxRead)
+    : m_delayUs(delayUs), m_maxRead(maxRead), m_pos(0), m_reads(0),
+    m_seeks(0)
+  {}
+
+  ssize_t Read(unsigned char *buffer, unsigned int size)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(m_delayUs));
+    ++m_reads;
+    if (m_pos >= SOURCE_LENGTH)
+      return 0;
+    /* vary the length of short reads */
+    unsigned int len = std::min<uint64_t>(std::min(size,
+          m_maxRead - (m_reads % 3) * 1000), SOURCE_LENGTH - m_pos);
+    for (unsigned int i = 0; i < len; ++i)
+      buffer[i] = Pattern(m_pos + i);
+    m_pos += len;
+    return len;
+  }
+
+  int64_t Seek(uint64_t position)
+  {
+    ++m_seeks;
+    m_pos = std::min<uint64_t>(position, SOURCE_LENGTH);
+    return m_pos;
+  }
+
+  unsigned int m_delayUs;
+  unsigned int m_maxRead;
+  uint64_t m_pos;
+  unsigned int m_reads;
+  unsigned int m_seeks;
+};
+
+/* reads count bytes (or up to the end) and verifies them against the
+ * pattern. returns the number of bytes read or -1 on a mismatch
+ */
+static int64_t ReadVerify(ReadAheadBuffer &buffer, uint64_t count,
+    unsigned int readSize, unsigned int consumerDelayUs)
+{
+  std::vector<unsigned char> data(readSize);
+  uint64_t position = buffer.Position();
+  uint64_t done = 0;
+  while (done < count)
+  {
+    unsigned int want = std::min<uint64_t>(readSize - done % 17, count - done);
+    ssize_t read = buffer.Read(data.data(), want);
+    if (read < 0)
+    {
+      printf("read failed at %llu\n",
+          static_cast<unsigned long long>(position + done));
+      return -1;
+    }
+    if (!read)
+      break;
+    for (ssize_t i = 0; i < read; ++i)
+    {
+      if (data[i] != Pattern(position + done + i))
+      {
+        printf("mismatch at %llu\n",
+            static_cast<unsigned long long>(position + done + i));
+        return -1;
+      }
+    }
+    done += read;
+    if (consumerDelayUs)
+      std::this_thread::sleep_for(std::chrono::microseconds(consumerDelayUs));
+  }
+  return done;
+}
+
+static unsigned int TestSequential(const char *name, unsigned int sourceDelayUs,
+    unsigned int consumerDelayUs, unsigned int readSize)
+{
+  FakeSource source(sourceDelayUs, 48 * 1024);
+  ReadAheadBuffer buffer(BUFFER_SIZE,
+      [&source] (unsigned char *data, unsigned int size)
+      {
+        return source.Read(data, size);
+      },
+      [&source] (uint64_t position)
+      {
+        return source.Seek(position);
+      });
+  if (!buffer.Start(0))
+  {
+    printf("%s: start failed\n", name);
+    return 1;
+  }
+
+  unsigned int failures = 0;
+  int64_t read = ReadVerify(buffer, SOURCE_LENGTH + 1, readSize,
+      consumerDelayUs);
+  if (read != SOURCE_LENGTH)
+  {
+    printf("%s: read %lld bytes, expected %d\n", name,
+        static_cast<long long>(read), SOURCE_LENGTH);
+    ++failures;
+  }
+
+  ReadAheadBuffer::Stats stats = buffer.GetStats();
+  if (stats.bytes != SOURCE_LENGTH || stats.hits + stats.underruns
+      != stats.reads || stats.connections != 1)
+  {
+    printf("%s: inconsistent stats\n", name);
+    ++failures;
+  }
+  printf("%s: reads=%u, hits=%u, underruns=%u, %u failures\n", name,
+      stats.reads, stats.hits, stats.underruns, failures);
+  return failures;
+}
+
+static unsigned int TestSeeks()
+{
+  FakeSource source(200, 64 * 1024);
+  ReadAheadBuffer buffer(BUFFER_SIZE,
+      [&source] (unsigned char *data, unsigned int size)
+      {
+        return source.Read(data, size);
+      },
+      [&source] (uint64_t position)
+      {
+        return source.Seek(position);
+      });
+  /* like a resumed recording. the source is positioned already */
+  const uint64_t start = 1000;
+  source.m_pos = start;
+  if (!buffer.Start(start))
+  {
+    printf("seeks: start failed\n");
+    return 1;
+  }
+
+  unsigned int failures = 0;
+  struct
+  {
+    uint64_t position;
+    uint64_t count;
+  } steps[] = {
+    { start, 100000 },
+    /* forward inside the buffered data once the fill thread caught up */
+    { start + 100000 + 1000, 5000 },
+    /* backwards, far forward and to the very end */
+    { 10, 70000 },
+    { 2 * 1024 * 1024, 300000 },
+    { 512 * 1024 + 3, 1 },
+    { SOURCE_LENGTH - 100, 100 },
+    { SOURCE_LENGTH, 0 },
+    { 0, 4096 },
+  };
+  for (auto &step : steps)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    if (buffer.Seek(step.position) != static_cast<int64_t>(step.position)
+        || buffer.Position() != static_cast<int64_t>(step.position))
+    {
+      printf("seeks: seek to %llu failed\n",
+          static_cast<unsigned long long>(step.position));
+      ++failures;
+      continue;
+    }
+    int64_t read = ReadVerify(buffer, step.count, 8192, 0);
+    if (read != static_cast<int64_t>(step.count))
+    {
+      printf("seeks: read %lld bytes at %llu, expected %llu\n",
+          static_cast<long long>(read),
+          static_cast<unsigned long long>(step.position),
+          static_cast<unsigned long long>(step.count));
+      ++failures;
+    }
+  }
+
+  /* nothing left after the end */
+  buffer.Seek(SOURCE_LENGTH);
+  if (ReadVerify(buffer, 1, 1, 0) != 0)
+  {
+    printf("seeks: data after the end\n");
+    ++failures;
+  }
+  printf("seeks: %u source seeks, %u failures\n", source.m_seeks, failures);
+  return failures;
+}
+
+int main()
+{
+  XBMC = new LogHelper();
+  unsigned int failures = 0;
+  /* the source is slower than the reader, so the reader has to wait */
+  failures += TestSequential("throttled", 2000, 0, 32 * 1024);
+  /* the reader is slower, so most reads are served from the buffer */
+  failures += TestSequential("buffered", 0, 300, 32 * 1024);
+  /* tiny reads as done by the demuxer while probing */
+  failures += TestSequential("small reads", 50, 0, 188);
+  failures += TestSeeks();
+  delete XBMC;
+  return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+/* Counts the heap allocations of the recording and timer ingestion per 1000
+ * entries. The extraction as it used to be (every field copied into a
+ * std::string, numbers through sscanf and istringstream) is compared with
+ * the StringView accessors and hand written parsers, which only materialize
+ * the fields handed over to Kodi. The allocations of the parser alone are
+ * listed as baseline. Nearly every field of a recording ends up in Kodi and
+ * the short attributes fit into std::string's inline buffer, so most of the
+ * savings are in the timer list.
+ */
+#include "StringView.h"
+#include "XmlPayloads.h"
+#include "XmlStreamParser.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+#define RECORDINGS 5000
+#define TIMERS     2000
+
+static unsigned long long g_allocations = 0;
+
+void *operator new(size_t size)
+{
+  ++g_allocations;
+  if (void *p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+/* the fields the add-on keeps of a recording and a timer */
+struct Recording
+{
+  std::string id, title, plotOutline, plot, channelName, thumbnail, group;
+  unsigned int genre, duration;
+  int year, month, day;
+};
+
+struct Timer
+{
+  std::string guid, title;
+  unsigned int backendId, duration, weekdays;
+  uint64_t channelId;
+  int priority, day, month, year, hour, minute, recording;
+  bool enabled;
+};
+
+static void RecordingCopies(const XmlElement &xRecording)
+{
+  Recording recording = Recording();
+  xRecording.GetAttribute("id", recording.id);
+  std::string content;
+  if (xRecording.GetAttribute("content", content))
+    recording.genre = atoi(content.c_str());
+  xRecording.GetString("title",   recording.title);
+  xRecording.GetString("info",    recording.plotOutline);
+  xRecording.GetString("desc",    recording.plot);
+  xRecording.GetString("channel", recording.channelName);
+  std::string thumbnail;
+  if (xRecording.GetString("image", thumbnail))
+    recording.thumbnail = "upnp/thumbnails/video/" + thumbnail;
+
+  std::string startTime;
+  xRecording.GetAttribute("start", startTime);
+  sscanf(startTime.c_str(), "%4d%2d%2d", &recording.year, &recording.month,
+      &recording.day);
+  std::string duration;
+  int hours = 0, mins = 0, secs = 0;
+  if (xRecording.GetAttribute("duration", duration))
+    sscanf(duration.c_str(), "%02d%02d%02d", &hours, &mins, &secs);
+  recording.duration = hours * 3600 + mins * 60 + secs;
+  xRecording.GetString("series", recording.group);
+}
+
+static void RecordingViews(const XmlElement &xRecording)
+{
+  Recording recording = Recording();
+  xRecording.GetAttribute("id", recording.id);
+  xRecording.QueryUnsignedAttribute("content", &recording.genre);
+  xRecording.GetString("title",   recording.title);
+  xRecording.GetString("info",    recording.plotOutline);
+  xRecording.GetString("desc",    recording.plot);
+  xRecording.GetString("channel", recording.channelName);
+  StringView thumbnail;
+  if (xRecording.GetView("image", thumbnail))
+  {
+    recording.thumbnail = "upnp/thumbnails/video/";
+    recording.thumbnail.append(thumbnail.data(), thumbnail.size());
+  }
+
+  StringView startTime, duration;
+  xRecording.Attribute("start", startTime);
+  StringParser::ParseDigits(startTime, 0, 4, recording.year);
+  StringParser::ParseDigits(startTime, 4, 2, recording.month);
+  StringParser::ParseDigits(startTime, 6, 2, recording.day);
+  int hours = 0, mins = 0, secs = 0;
+  if (xRecording.Attribute("duration", duration))
+  {
+    StringParser::ParseDigits(duration, 0, 2, hours);
+    StringParser::ParseDigits(duration, 2, 2, mins);
+    StringParser::ParseDigits(duration, 4, 2, secs);
+  }
+  recording.duration = hours * 3600 + mins * 60 + secs;
+  xRecording.GetString("series", recording.group);
+}
+
+static void TimerCopies(const XmlElement &xTimer)
+{
+  Timer timer = Timer();
+  xTimer.GetString("GUID", timer.guid);
+  std::string value;
+  if (xTimer.GetString("ID", value))
+    timer.backendId = atoi(value.c_str());
+  xTimer.GetString("Descr", timer.title);
+
+  const XmlElement *xChannel = xTimer.FirstChildElement("Channel");
+  std::string channelId;
+  if (xChannel && xChannel->GetAttribute("ID", channelId))
+  {
+    std::istringstream ss(channelId);
+    ss >> timer.channelId;
+  }
+
+  std::string date, start;
+  xTimer.GetAttribute("Date", date);
+  xTimer.GetAttribute("Start", start);
+  std::string startDate = date + start;
+  sscanf(startDate.c_str(), "%2d.%2d.%4d%2d:%2d", &timer.day, &timer.month,
+      &timer.year, &timer.hour, &timer.minute);
+  if (xTimer.GetAttribute("Dur", value))
+    timer.duration = atoi(value.c_str());
+
+  std::string weekdays;
+  xTimer.GetAttribute("Days", weekdays);
+  timer.weekdays = 0;
+  for (unsigned int j = 0; j < weekdays.size(); ++j)
+  {
+    if (weekdays[j] != '-')
+      timer.weekdays += (1 << j);
+  }
+  if (xTimer.GetAttribute("Priority", value))
+    timer.priority = atoi(value.c_str());
+  timer.enabled = !(xTimer.GetAttribute("Enabled", value) && value == "0");
+  if (xTimer.GetString("Recording", value))
+    timer.recording = atoi(value.c_str());
+}
+
+static void TimerViews(const XmlElement &xTimer)
+{
+  Timer timer = Timer();
+  xTimer.GetString("GUID", timer.guid);
+  xTimer.GetUInt("ID", timer.backendId);
+  xTimer.GetString("Descr", timer.title);
+
+  const XmlElement *xChannel = xTimer.FirstChildElement("Channel");
+  StringView channelId;
+  if (xChannel && xChannel->Attribute("ID", channelId))
+    StringParser::ParseUnsigned(channelId, timer.channelId);
+
+  StringView date, start, value;
+  xTimer.Attribute("Date", date);
+  xTimer.Attribute("Start", start);
+  StringParser::ParseDigits(date, 0, 2, timer.day);
+  StringParser::ParseDigits(date, 3, 2, timer.month);
+  StringParser::ParseDigits(date, 6, 4, timer.year);
+  StringParser::ParseDigits(start, 0, 2, timer.hour);
+  StringParser::ParseDigits(start, 3, 2, timer.minute);
+  if (xTimer.Attribute("Dur", value))
+    StringParser::ParseUnsigned(value, timer.duration);
+
+  StringView weekdays;
+  xTimer.Attribute("Days", weekdays);
+  timer.weekdays = 0;
+  for (unsigned int j = 0; j < weekdays.size(); ++j)
+  {
+    if (weekdays[j] != '-')
+      timer.weekdays += (1 << j);
+  }
+  if (xTimer.Attribute("Priority", value))
+    StringParser::ParseSigned(value, timer.priority);
+  timer.enabled = !(xTimer.Attribute("Enabled", value) && !value.empty()
+      && value[0] == '0');
+  xTimer.GetInt("Recording", timer.recording);
+}
+
+/*!< @return allocations per 1000 entries */
+static double Count(const std::string &payload, const char *entryName,
+    XmlStreamParser::EntryFunc_t entryFunc)
+{
+  unsigned long long before = g_allocations;
+  XmlStreamParser parser(entryName, entryFunc);
+  if (!parser.Feed(payload.data(), payload.size()) || !parser.Finish()
+      || !parser.Entries())
+  {
+    printf("%s: parsing failed: %s\n", entryName, parser.ErrorDesc().c_str());
+    exit(EXIT_FAILURE);
+  }
+  return (g_allocations - before) * 1000.0 / parser.Entries();
+}
+
+static unsigned int Benchmark(const char *name, const std::string &payload,
+    const char *entryName, XmlStreamParser::EntryFunc_t copies,
+    XmlStreamParser::EntryFunc_t views)
+{
+  double parser = Count(payload, entryName, [] (const XmlElement &) {});
+  double before = Count(payload, entryName, copies);
+  double after  = Count(payload, entryName, views);
+  printf("%-10s allocations per 1000 entries: parser %.0f, copies %.0f, "
+      "views %.0f (%.0f%% less)\n", name, parser, before, after,
+      (before > 0) ? (before - after) * 100 / before : 0.0);
+  if (after > before)
+  {
+    printf("%s: the views allocate more than the copies\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+int main()
+{
+  std::string recordings = XmlPayloads::Recordings(RECORDINGS);
+  std::string timers = XmlPayloads::TimerList(TIMERS);
+  unsigned int failures = 0;
+  failures += Benchmark("recordings", recordings, "recording",
+      RecordingCopies, RecordingViews);
+  failures += Benchmark("timers", timers, "Timer", TimerCopies, TimerViews);
+  return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+/* Parses a synthetic recordings.xml with XmlParallelParser on one thread
+ * and on up to as many threads as there are cores. Every run must return the
+ * same recordings in document order, and a truncated document must still be
+ * rejected. The speedup depends on the machine, so it's only printed.
+ */
+#include "XmlParallelParser.h"
+#include "XmlPayloads.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#define RECORDINGS 20000
+#define RUNS       5
+
+struct Recording
+{
+  std::string id, title, plot, channelName;
+  unsigned int genre;
+};
+
+static bool ParseRecording(const XmlElement &xRecording, Recording &recording)
+{
+  if (!xRecording.GetAttribute("id", recording.id))
+    return false;
+  recording.genre = 0;
+  xRecording.QueryUnsignedAttribute("content", &recording.genre);
+  xRecording.GetString("title",   recording.title);
+  xRecording.GetString("desc",    recording.plot);
+  xRecording.GetString("channel", recording.channelName);
+  return true;
+}
+
+/*!< @return best time of RUNS runs in ms or a negative value on failure */
+static double Measure(const std::string &payload, unsigned int threads,
+    std::vector<Recording> &recordings)
+{
+  double best = -1.0;
+  for (unsigned int i = 0; i < RUNS; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    XmlParallelParser parser("recording", threads);
+    if (!parser.Parse(payload, ParseRecording, recordings))
+    {
+      printf("%u threads: %s\n", threads, parser.ErrorDesc().c_str());
+      return -1.0;
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+    if (best < 0 || elapsed.count() < best)
+      best = elapsed.count();
+  }
+  return best;
+}
+
+static bool Equal(const std::vector<Recording> &a,
+    const std::vector<Recording> &b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    if (a[i].id != b[i].id || a[i].title != b[i].title
+        || a[i].plot != b[i].plot || a[i].channelName != b[i].channelName
+        || a[i].genre != b[i].genre)
+      return false;
+  }
+  return true;
+}
+
+int main()
+{
+  std::string payload = XmlPayloads::Recordings(RECORDINGS);
+  unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+  unsigned int failures = 0;
+
+  std::vector<Recording> sequential;
+  double sequentialTime = Measure(payload, 1, sequential);
+  if (sequentialTime < 0 || sequential.size() != RECORDINGS)
+  {
+    printf("sequential parse failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("%u recordings, %.1f MiB: 1 thread %.1f ms\n", RECORDINGS,
+      payload.size() / (1024.0 * 1024.0), sequentialTime);
+
+  // more threads than cores still has to work
+  std::vector<unsigned int> threadCounts = { 2, 4 };
+  if (cores > 4)
+    threadCounts.push_back(cores);
+  for (unsigned int threads : threadCounts)
+  {
+    std::vector<Recording> parallel;
+    double time = Measure(payload, threads, parallel);
+    if (time < 0 || !Equal(sequential, parallel))
+    {
+      printf("%u threads: results differ from the sequential parse\n",
+          threads);
+      ++failures;
+      continue;
+    }
+    printf("%u threads %.1f ms, %.2fx\n", threads, time,
+        sequentialTime / time);
+  }
+
+  // the end of the root element is missing
+  std::string truncated = payload.substr(0, payload.rfind("</recordings>"));
+  std::vector<Recording> ignored;
+  XmlParallelParser parser("recording", 4);
+  if (parser.Parse(truncated, ParseRecording, ignored))
+  {
+    printf("a truncated document was accepted\n");
+    ++failures;
+  }
+  return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
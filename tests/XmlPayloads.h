@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef PVR_DVBVIEWER_TESTS_XMLPAYLOADS_H
+#define PVR_DVBVIEWER_TESTS_XMLPAYLOADS_H
+
+#include <cstdio>
+#include <string>
+
+/* Synthetic responses of the recording service, shaped like the real ones:
+ * api/recordings.html with a long description per recording and
+ * api/timerlist.html with nested option and channel elements.
+ */
+namespace XmlPayloads
+{
+  /*!< @brief recordings.xml with count recordings. Some backends pad the
+   * response with NUL characters, nulInterval adds one every that many bytes
+   * (0 for none)
+   */
+  inline std::string Recordings(unsigned int count, size_t nulInterval = 0)
+  {
+    std::string xml = "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n"
+      "<recordings Ver=\"1\">\n"
+      "<serverURL>http://192.168.0.10:8089/</serverURL>\n";
+    char buffer[2048];
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      snprintf(buffer, sizeof(buffer),
+          "<recording id=\"%u\" charset=\"255\" content=\"%u\" "
+          "start=\"2017%02u%02u%02u%02u00\" duration=\"01%02u00\">\n"
+          "<channel>Channel %04u HD</channel>\n"
+          "<file>D:\\Recordings\\Series %u\\Episode_%u.ts</file>\n"
+          "<title>Series %u &amp; Friends</title>\n"
+          "<info>Episode %u</info>\n"
+          "<desc>A rather long description of episode %u which goes on for "
+          "a while, just like the ones delivered by the broadcasters do. It "
+          "mentions actors, places &amp; plots. Lorem ipsum dolor sit amet, "
+          "consectetur adipiscing elit, sed do eiusmod tempor incididunt ut "
+          "labore et dolore magna aliqua.</desc>\n"
+          "<series>Series %u</series>\n"
+          "<image>%u.jpg</image>\n"
+          "</recording>\n",
+          i, (i % 16) * 16, i % 12 + 1, i % 28 + 1, i % 24, i % 60, i % 60,
+          i % 2000, i % 50, i, i % 50, i, i, i % 50, i);
+      xml += buffer;
+    }
+    xml += "</recordings>\n";
+
+    if (!nulInterval)
+      return xml;
+    std::string padded;
+    padded.reserve(xml.size() + xml.size() / nulInterval + 1);
+    for (size_t pos = 0; pos < xml.size(); pos += nulInterval)
+    {
+      padded.append(xml, pos, nulInterval);
+      padded += '\0';
+    }
+    return padded;
+  }
+
+  /*!< @brief timerlist.xml with count timers */
+  inline std::string TimerList(unsigned int count)
+  {
+    std::string xml = "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n"
+      "<Timers>\n";
+    char buffer[2048];
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      snprintf(buffer, sizeof(buffer),
+          "<Timer Type=\"1\" Enabled=\"%s\" Priority=\"50\" Charset=\"255\" "
+          "Date=\"%02u.%02u.2017\" Start=\"%02u:%02u:00\" Dur=\"%u\" "
+          "End=\"23:59:00\" Days=\"%s\" Action=\"0\">\n"
+          "<Descr>Timer %u &amp; more</Descr>\n"
+          "<Options AdjustPAT=\"-1\" AllAudio=\"-1\" DVBSubs=\"-1\" "
+          "Teletext=\"-1\"/>\n"
+          "<Format>2</Format>\n"
+          "<Folder>Auto</Folder>\n"
+          "<NameScheme>%%event_%%date_%%time</NameScheme>\n"
+          "<Source>Kodi</Source>\n"
+          "<Channel ID=\"%llu|Channel %04u HD\"/>\n"
+          "<Executeable>-1</Executeable>\n"
+          "<Recording>%d</Recording>\n"
+          "<ID>%u</ID>\n"
+          "<GUID>{%08X-1234-5678-9ABC-DEF012345678}</GUID>\n"
+          "</Timer>\n",
+          (i % 5) ? "-1" : "0", i % 28 + 1, i % 12 + 1, i % 24, i % 60,
+          30 + i % 90, (i % 3) ? "-------" : "TTTTT--", i,
+          1000000000000000000ULL + i % 2000, i % 2000, (i % 7) ? 0 : -1, i,
+          i);
+      xml += buffer;
+    }
+    xml += "</Timers>\n";
+    return xml;
+  }
+}
+
+#endif
@@ -0,0 +1,132 @@
+/* Compares the XmlScan kernels against the scalar code they replaced on
+ * synthetic recordings.xml and timerlist.xml responses: stripping NULs
+ * (formerly std::remove over the whole response) and finding markup
+ * boundaries (formerly a byte by byte loop). Both variants must produce the
+ * same result. The throughput of the complete parse is printed for
+ * reference.
+ */
+#include "XmlPayloads.h"
+#include "XmlScan.h"
+#include "XmlStreamParser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#define RUNS 20
+
+/*!< @brief best time of RUNS runs in ms */
+static double Measure(const std::function<void ()> &func)
+{
+  double best = 0.0;
+  for (unsigned int i = 0; i < RUNS; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+    if (!i || elapsed.count() < best)
+      best = elapsed.count();
+  }
+  return best;
+}
+
+static void Report(const char *name, const char *step, size_t size,
+    double scalar, double vector)
+{
+  double mib = size / (1024.0 * 1024.0);
+  printf("%-12s %-10s scalar %7.1f MiB/s, XmlScan %7.1f MiB/s, %.2fx\n",
+      name, step, mib / scalar * 1000, mib / vector * 1000, scalar / vector);
+}
+
+static size_t ScalarStripNul(std::string &data)
+{
+  data.erase(std::remove(data.begin(), data.end(), '\0'), data.end());
+  return data.size();
+}
+
+static size_t ScalarCountBoundaries(const std::string &data)
+{
+  size_t count = 0;
+  for (char c : data)
+  {
+    if (c == '<' || c == '>' || c == '"')
+      ++count;
+  }
+  return count;
+}
+
+static size_t CountBoundaries(const std::string &data)
+{
+  size_t count = 0;
+  const char *end = data.data() + data.size();
+  for (const char *p = XmlScan::FindAny(data.data(), end, '<', '>', '"');
+      p != end; p = XmlScan::FindAny(p + 1, end, '<', '>', '"'))
+    ++count;
+  return count;
+}
+
+static unsigned int Benchmark(const char *name, const std::string &payload,
+    const char *entryName, unsigned int entries)
+{
+  unsigned int failures = 0;
+
+  std::string scalarStripped, stripped;
+  double scalar = Measure([&] ()
+  {
+    scalarStripped = payload;
+    ScalarStripNul(scalarStripped);
+  });
+  double vector = Measure([&] ()
+  {
+    stripped = payload;
+    stripped.resize(XmlScan::StripNul(&stripped[0], stripped.size()));
+  });
+  if (stripped != scalarStripped)
+  {
+    printf("%s: StripNul differs from std::remove\n", name);
+    ++failures;
+  }
+  /* both include copying the payload, so the real gap is larger */
+  Report(name, "strip NUL", payload.size(), scalar, vector);
+
+  size_t scalarCount = 0, count = 0;
+  scalar = Measure([&] () { scalarCount = ScalarCountBoundaries(stripped); });
+  vector = Measure([&] () { count = CountBoundaries(stripped); });
+  if (count != scalarCount)
+  {
+    printf("%s: FindAny found %zu boundaries instead of %zu\n", name, count,
+        scalarCount);
+    ++failures;
+  }
+  Report(name, "boundaries", stripped.size(), scalar, vector);
+
+  unsigned int parsed = 0;
+  double parse = Measure([&] ()
+  {
+    XmlStreamParser parser(entryName, [] (const XmlElement &) {});
+    if (parser.Feed(payload.data(), payload.size()) && parser.Finish())
+      parsed = parser.Entries();
+  });
+  if (parsed != entries)
+  {
+    printf("%s: parsed %u entries instead of %u\n", name, parsed, entries);
+    ++failures;
+  }
+  printf("%-12s %-10s %7.1f MiB/s for %u entries\n", name, "parse",
+      payload.size() / (1024.0 * 1024.0) / parse * 1000, entries);
+  return failures;
+}
+
+int main()
+{
+  unsigned int failures = 0;
+  failures += Benchmark("recordings", XmlPayloads::Recordings(5000),
+      "recording", 5000);
+  failures += Benchmark("recordings+0", XmlPayloads::Recordings(5000, 4096),
+      "recording", 5000);
+  failures += Benchmark("timerlist", XmlPayloads::TimerList(1000), "Timer",
+      1000);
+  return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}